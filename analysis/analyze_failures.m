@@ -40,7 +40,7 @@ function [failure_histograms] = analyze_failures(experiment, trackers, sequences
                 result_file = fullfile(result_directory, sprintf('%s_%03d.txt', experiment_sequences{s}.name, j));
                 
                 try 
-                    trajectory = read_trajectory(result_file);
+                    trajectory = read_trajectory(result_file, 'cell', trajectory_cache());
                 catch
                     continue;
                 end;
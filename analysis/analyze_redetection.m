@@ -63,7 +63,7 @@ function [redetected, lengths] = calculate_redetection(sequence, experiment, tra
         result_file = fullfile(result_directory, sprintf('%s_%03d.txt', sequence.name, r));
 
         try 
-            trajectory = read_trajectory(result_file);
+            trajectory = read_trajectory(result_file, 'cell', trajectory_cache());
         catch
             continue;
         end;
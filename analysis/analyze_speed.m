@@ -69,19 +69,26 @@ function context = speed_iterator(event, context)
             
             reliability = nan(repeat, 1);
 			failures = cell(repeat, 1);
+            fresh = true(repeat, 1);
 
             for j = 1:repeat
 
                 result_file = fullfile(directory, event.sequence.name, sprintf('%s_%03d.txt', event.sequence.name, j));
 
                 try 
-                    trajectory = read_trajectory(result_file);
+                    trajectory = read_trajectory(result_file, 'cell', trajectory_cache());
                 catch
                     continue;
                 end;
 
                 [reliability(j), failures{j}] = estimate_failures(trajectory, event.sequence);
 
+                % Repetitions that reused a running tracker process did not include its startup
+                startup_file = fullfile(directory, event.sequence.name, sprintf('%s_%03d_startup.txt', event.sequence.name, j));
+                if exist(startup_file, 'file')
+                    fresh(j) = csvread(startup_file) > 0;
+                end;
+
             end;            
             
 			times_file = fullfile(directory, event.sequence.name, ...
@@ -116,7 +123,7 @@ function context = speed_iterator(event, context)
                     skip_initialize = event.experiment.parameters.skip_initialize;
                 end;
                 average_normalized = mean(normalize_speed(average_speed, ...
-                    failures(valid), skip_initialize, event.tracker, event.sequence));
+                    failures(valid), skip_initialize, event.tracker, event.sequence, fresh(valid)));
             else
 				average_normalized = NaN;
                 print_debug('Warning: No performance profile for tracker %s.', event.tracker.identifier);
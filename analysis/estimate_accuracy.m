@@ -67,11 +67,7 @@ else
     bounds = bind_within;
 end;
 
-if isstruct(sequence)
-    frames = calculate_overlap(trajectory, sequence_get_region(sequence, 1:sequence.length), bounds);
-else
-    frames = calculate_overlap(trajectory, sequence, bounds);
-end;
+frames = calculate_overlap(trajectory, sequence, bounds);
 
 if ~ignore_unknown
     frames(unknown) = 0;
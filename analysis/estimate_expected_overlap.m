@@ -187,19 +187,25 @@ switch (event.type)
         switch event.experiment.type
             case {'supervised', 'realtime'}
 
-                for i = 1:event.experiment.parameters.repetitions
+                repetitions = event.experiment.parameters.repetitions;
 
-                    result_file = fullfile(sequence_directory, sprintf('%s_%03d.txt', event.sequence.name, i));
+                if repetitions > 3 && is_deterministic(sequence, 3, sequence_directory)
+                    repetitions = 3;
+                end;
 
-                    if i == 4 && is_deterministic(sequence, 3, sequence_directory)
-                        break;
-                    end;
+                result_files = arrayfun(@(i) fullfile(sequence_directory, sprintf('%s_%03d.txt', event.sequence.name, i)), ...
+                    1:repetitions, 'UniformOutput', false);
+
+                [trajectories, status] = read_trajectories(result_files, ...
+                    get_global_variable('native_threads', 0), 'cell', trajectory_cache());
+
+                for i = 1:repetitions
 
-                    if ~exist(result_file, 'file')
+                    if ~status(i)
                         continue;
                     end;
 
-                    trajectory = read_trajectory(result_file);
+                    trajectory = trajectories{i};
 
                     [~, frames] = estimate_accuracy(trajectory, sequence);
 
@@ -1,8 +1,11 @@
-function [normalized_speed, actual_speed] = normalize_speed(speed, failures, skipping, tracker, sequence)
+function [normalized_speed, actual_speed] = normalize_speed(speed, failures, skipping, tracker, sequence, fresh)
 % normalize_speed Normalizes tracker speed estimate
 %
 % This function normalizes speed estimates based on performance profile and some information about 
 % the way the measurement was obtained (sequence, number of failures, frame skipping).
+% If the metadata of the tracker specifies the number of threads that the tracker uses
+% and the profile contains a multi-core scaling curve, the normalization factor is
+% divided by the speedup of the benchmark at that number of threads.
 %
 % Input:
 % - speed (double): The initial speed estimate.
@@ -10,6 +13,9 @@ function [normalized_speed, actual_speed] = normalize_speed(speed, failures, ski
 % - skipping (integer): Number of skipped frames after each failure.
 % - tracker (structure): A valid tracker descriptor.
 % - sequence (structure): A valid sequence descriptor.
+% - fresh (boolean, optional): A vector that denotes for every measurement if the tracker
+%   process was started for it (see tracker_session). The startup time is only
+%   subtracted for such measurements. Default: true for all.
 %
 % Output:
 % - normalized_speed (double): Normalized speed estimate.
@@ -22,9 +28,24 @@ end;
 
 performance = tracker.performance;
 
+if nargin < 6
+    fresh = true(numel(speed), 1);
+end;
+
 factor = performance.nonlinear_native;
 startup = 0;
 
+if isfield(tracker.metadata, 'threads') && isfield(performance, 'scaling_rate') && ...
+        all(isfinite(performance.scaling_rate)) && numel(performance.scaling_rate) > 1
+    threads = tracker.metadata.threads;
+    if threads < 1
+        threads = performance.scaling_threads(end);
+    end;
+    threads = min(max(threads, 1), performance.scaling_threads(end));
+    speedup = interp1(performance.scaling_threads, performance.scaling_rate, threads) / performance.scaling_rate(1);
+    factor = factor / speedup;
+end;
+
 if strcmpi(tracker.interpreter, 'matlab')
     if isfield(performance, 'matlab_startup')
         startup = performance.matlab_startup;
@@ -41,11 +62,11 @@ failure_count = cellfun(@(x) numel(x), failures, 'UniformOutput', true);
 if tracker.trax
 	actual_length = sequence.length - (skipping - 1) * failure_count;
 	full_length = sequence.length;
-	startup_time = startup * (1 + failure_count);
+	startup_time = startup * (1 + failure_count) .* fresh(:);
 else
 	full_length = cellfun(@(x) sum(sequence.length - x - (skipping - 1)), failures, 'UniformOutput', true) + sequence.length;
 	actual_length = full_length;
-	startup_time = startup * (1 + failure_count);
+	startup_time = startup * (1 + failure_count) .* fresh(:);
 end;
 
 actual_speed = (((speed .* full_length) - startup_time) ./ actual_length);
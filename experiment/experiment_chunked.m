@@ -2,6 +2,7 @@ function [files, metadata] = experiment_chunked(tracker, sequence, directory, pa
 
     files = {};
     metadata.completed = true;
+    metadata.pending = [];
     cache = get_global_variable('experiment.cache', true);
     silent = get_global_variable('experiment.silent', 0);
 
@@ -11,14 +12,6 @@ function [files, metadata] = experiment_chunked(tracker, sequence, directory, pa
 
     [chunks, chunk_offset] = sequence_fragment(sequence, context.chunk_length);
 
-    time_file = fullfile(directory, sprintf('%s_time.txt', sequence.name));
-
-    times = zeros(sequence.length, context.repetitions);
-
-    if ~scan && cache && exist(time_file, 'file')
-        times = csvread(time_file);
-    end;
-
 	r = context.repetitions;
 
 	if isfield(tracker, 'metadata') && isfield(tracker.metadata, 'deterministic') && tracker.metadata.deterministic
@@ -27,8 +20,15 @@ function [files, metadata] = experiment_chunked(tracker, sequence, directory, pa
     
     check_deterministic = ~(scan && nargout < 2);
 
+    [times, time_file, worker_repetition] = experiment_workers(mfilename, tracker, sequence, directory, parameters, ...
+        context.repetitions, r, scan, cache, false);
+
     for i = 1:r
 
+        if ~isempty(worker_repetition) && i ~= worker_repetition
+            continue;
+        end;
+
         result_file = fullfile(directory, sprintf('%s_%03d.txt', sequence.name, i));
 
         if cache && exist(result_file, 'file')
@@ -38,7 +38,7 @@ function [files, metadata] = experiment_chunked(tracker, sequence, directory, pa
             continue;
         end;
 
-        if check_deterministic && i == 4 && is_deterministic(sequence, 3, directory)
+        if check_deterministic && (i == 4 || (~isempty(worker_repetition) && i > 4)) && is_deterministic(sequence, 3, directory)
             if ~silent
                 print_debug('Detected a deterministic tracker, skipping remaining trials.');
             end;
@@ -48,6 +48,7 @@ function [files, metadata] = experiment_chunked(tracker, sequence, directory, pa
 
         if scan
             metadata.completed = false;
+            metadata.pending(end+1) = i;
             continue;
         end;
 
@@ -59,6 +60,8 @@ function [files, metadata] = experiment_chunked(tracker, sequence, directory, pa
 
         trajectory = cell(sequence.length, 1);
         time = zeros(sequence.length, 1);
+        prefetched = [0, 0];
+        channels = {};
 
         for c = 1:numel(chunks)
 
@@ -67,15 +70,36 @@ function [files, metadata] = experiment_chunked(tracker, sequence, directory, pa
 			data.context = context;
 			data.result = repmat({0}, chunks{c}.length, 1);
 			data.timing = nan(chunks{c}.length, 1);
-            data.channels = {};
-            
-			data = tracker_run(tracker, @callback, data);
+            data.channels = channels;
+            data.prefetch = [];
+
+            % The channels are known after the first chunk, later chunks start
+            % their prefetcher here so that it is also closed if the tracker fails
+            if ~isempty(channels)
+                data.prefetch = sequence_prefetch(data.sequence, channels);
+            end;
+
+            try
+                data = tracker_run(tracker, @callback, data);
+            catch e
+                abort_repetition(data);
+                rethrow(e);
+            end;
+
+            channels = data.channels;
+
+            if ~isempty(data.prefetch)
+                statistics = frame_prefetch('close', data.prefetch);
+                prefetched = prefetched + [statistics.hits, statistics.misses];
+            end;
 
             trajectory(chunk_offset(c):chunk_offset(c)+numel(data.result)-1) = data.result;
             time(chunk_offset(c):chunk_offset(c)+numel(data.result)-1) = data.timing;
 
         end;
 
+        print_text('Prefetched images: %d hits, %d misses', prefetched(1), prefetched(2));
+
 		times(:, i) = time;
 		write_trajectory(result_file, trajectory);
 		csvwrite(time_file, times);
@@ -95,6 +119,14 @@ function [files, metadata] = experiment_chunked(tracker, sequence, directory, pa
 
 end
 
+function abort_repetition(data)
+
+    if ~isempty(data.prefetch)
+        frame_prefetch('close', data.prefetch);
+    end;
+
+end
+
 function [image, region, properties, data] = callback(state, data)
 
 	region = [];
@@ -106,12 +138,13 @@ function [image, region, properties, data] = callback(state, data)
             error('Sequence does not contain all channels required by the tracker.');
         end;
         data.channels = state.channels;
+        data.prefetch = sequence_prefetch(data.sequence, data.channels);
     end;
     
 	% Handle initial frame (initialize for the first time)
 	if isempty(state.region)
 		region = data.sequence.initialize(data.sequence, data.index, data.context);
-		image = sequence_get_image(data.sequence, data.index, data.channels);
+		image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
 		return;
 	end;
 
@@ -135,7 +168,7 @@ function [image, region, properties, data] = callback(state, data)
 		return;
 	end
 
-    image = sequence_get_image(data.sequence, data.index, data.channels);
+    image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
 
 end
 
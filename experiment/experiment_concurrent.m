@@ -0,0 +1,106 @@
+function times = experiment_concurrent(experiment_function, tracker, sequence, directory, parameters, repetitions, times, time_file)
+% experiment_concurrent Run repetitions of an experiment concurrently
+%
+% Runs the missing repetitions of an experiment for a tracker and a sequence in
+% separate worker processes. Every worker runs a single repetition with its own
+% TraX session and is pinned to its own set of processors (see run_processes),
+% the number of workers is set by the global variable experiment_concurrency
+% (0 uses all available processors) and the number of processors of a worker by
+% experiment_cores. The first three repetitions are run before the remaining
+% ones so that deterministic trackers are still detected. Workers store their
+% results in the same files as the serial loop of the experiment, their timing
+% is merged into the timing matrix (see experiment_merge_timing). Repetitions
+% that fail are left to the serial loop of the experiment.
+%
+% Input:
+% - experiment_function (string): Name of the experiment function.
+% - tracker (structure): A valid tracker descriptor.
+% - sequence (structure): A valid sequence descriptor.
+% - directory (string): Directory of the results.
+% - parameters (structure): Parameters of the experiment.
+% - repetitions (integer): Number of repetitions of the experiment.
+% - times (matrix): Timing matrix of the experiment.
+% - time_file (string): Path to the timing file of the experiment.
+%
+% Output:
+% - times (matrix): Timing matrix with the columns of the completed repetitions.
+%
+
+pending = [];
+
+for i = 1:repetitions
+    if ~exist(fullfile(directory, sprintf('%s_%03d.txt', sequence.name, i)), 'file')
+        pending(end+1) = i; %#ok<AGROW>
+    end;
+end;
+
+if repetitions > 3
+    first = pending(pending <= 3);
+    [times, completed] = run_batch(experiment_function, tracker, sequence, directory, parameters, first, times, time_file);
+    if ~completed || is_deterministic(sequence, 3, directory)
+        return;
+    end;
+    pending = pending(pending > 3);
+end;
+
+times = run_batch(experiment_function, tracker, sequence, directory, parameters, pending, times, time_file);
+
+end
+
+function [times, completed] = run_batch(experiment_function, tracker, sequence, directory, parameters, batch, times, time_file)
+
+completed = true;
+
+if isempty(batch)
+    return;
+end;
+
+print_text('Running repetitions %s concurrently', strjoin(arrayfun(@(i) sprintf('%d', i), batch, 'UniformOutput', false), ', '));
+
+job_directory = fullfile(get_global_variable('directory'), 'cache', 'concurrent');
+mkpath(job_directory);
+
+log_directory = fullfile(get_global_variable('directory'), 'logs', tracker.identifier);
+mkpath(log_directory);
+
+timestamp = datestr(now, 30);
+
+job_file = fullfile(job_directory, sprintf('%s_%s_%s.mat', tracker.identifier, sequence.name, timestamp));
+globals = get_global_variable(); %#ok<NASGU>
+save(job_file, 'tracker', 'sequence', 'directory', 'parameters', 'globals');
+
+commands = cell(numel(batch), 1);
+logs = cell(numel(batch), 1);
+
+for j = 1:numel(batch)
+    script = sprintf(['addpath(''%s''); toolkit_path; load(''%s''); set_global_variable(globals); ', ...
+        'set_global_variable(''experiment_repetition'', %d); %s(tracker, sequence, directory, parameters, false)'], ...
+        get_global_variable('toolkit_path'), job_file, batch(j), experiment_function);
+    commands{j} = generate_worker_command(script);
+    logs{j} = fullfile(log_directory, sprintf('%s_%s_%03d.log', timestamp, sequence.name, batch(j)));
+end;
+
+status = run_processes(commands, get_global_variable('experiment_concurrency', 1), ...
+    get_global_variable('experiment_cores', 1), [], logs);
+
+delete(job_file);
+
+cleanup = get_global_variable('log_autocleanup', true);
+
+[times, merged] = experiment_merge_timing(sequence, directory, times, time_file);
+
+% A worker that exits without an error has still failed if it did not store
+% the results of its repetition
+for j = 1:numel(batch)
+    result_file = fullfile(directory, sprintf('%s_%03d.txt', sequence.name, batch(j)));
+    if status(j) == 0 && any(merged == batch(j)) && exist(result_file, 'file')
+        if cleanup
+            delete(logs{j});
+        end;
+    else
+        print_text('Repetition %d failed, see %s', batch(j), logs{j});
+        completed = false;
+    end;
+end;
+
+end
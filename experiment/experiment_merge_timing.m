@@ -0,0 +1,43 @@
+function [times, merged] = experiment_merge_timing(sequence, directory, times, time_file)
+% experiment_merge_timing Merge timing of repetitions that were run by workers
+%
+% A repetition that is run by a worker process (see experiment_concurrent and the
+% native mode of workspace_evaluate) stores its timing in a partial file next to
+% its result file. This function copies the timing of every repetition that was
+% completed to the timing matrix, removes the partial files and writes the timing
+% file if anything changed.
+%
+% Input:
+% - sequence (structure): A valid sequence descriptor.
+% - directory (string): Directory of the results.
+% - times (matrix): Timing matrix of the experiment.
+% - time_file (string): Path to the timing file of the experiment.
+%
+% Output:
+% - times (matrix): Timing matrix with the merged columns.
+% - merged (vector): Indices of the merged repetitions.
+%
+
+merged = [];
+
+parts = dir(fullfile(directory, sprintf('%s_*_time.part', sequence.name)));
+
+for k = 1:numel(parts)
+
+    i = sscanf(parts(k).name(numel(sequence.name)+2:end), '%d_time.part');
+
+    if isempty(i) || ~exist(fullfile(directory, sprintf('%s_%03d.txt', sequence.name, i)), 'file')
+        continue;
+    end;
+
+    timing = csvread(fullfile(directory, parts(k).name));
+    times(:, i) = timing(:, i);
+    delete(fullfile(directory, parts(k).name));
+
+    merged(end+1) = i; %#ok<AGROW>
+
+end;
+
+if ~isempty(merged)
+    csvwrite(time_file, times);
+end;
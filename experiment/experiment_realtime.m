@@ -1,7 +1,13 @@
-function [files, metadata] = experiment_realtime(tracker, sequence, directory, parameters, scan)
+function [files, metadata] = experiment_realtime(tracker, sequence, directory, parameters, scan, defer)
+
+if nargin < 6
+    defer = false;
+end;
 
 files = {};
 metadata.completed = true;
+metadata.pending = [];
+metadata.tasks = {};
 cache = get_global_variable('experiment_cache', true);
 silent = get_global_variable('experiment_silent', false);
 
@@ -19,14 +25,6 @@ if context.default_fps <= 0
     error('Illegal FPS specification');
 end;
 
-time_file = fullfile(directory, sprintf('%s_time.txt', sequence.name));
-
-times = zeros(sequence.length, context.repetitions);
-
-if ~scan && cache && exist(time_file, 'file')
-    times = csvread(time_file);
-end;
-
 r = context.repetitions;
 
 if isfield(tracker, 'metadata') && isfield(tracker.metadata, 'deterministic') && tracker.metadata.deterministic
@@ -35,8 +33,15 @@ end
 
 check_deterministic = ~(scan && nargout < 2); % Ensure faster execution when we only want a list of files by ommiting determinisim check.
 
+[times, time_file, worker_repetition] = experiment_workers(mfilename, tracker, sequence, directory, parameters, ...
+    context.repetitions, r, scan, cache, defer);
+
 for i = 1:r
 
+    if ~isempty(worker_repetition) && i ~= worker_repetition
+        continue;
+    end;
+
     result_file = fullfile(directory, sprintf('%s_%03d.txt', sequence.name, i));
 
     if cache && exist(result_file, 'file')
@@ -46,7 +51,7 @@ for i = 1:r
         continue;
     end;
 
-    if check_deterministic && i == 4 && is_deterministic(sequence, 3, directory)
+    if check_deterministic && (i == 4 || (~isempty(worker_repetition) && i > 4)) && is_deterministic(sequence, 3, directory)
         if ~silent
             print_debug('Detected a deterministic tracker, skipping remaining trials.');
         end;
@@ -56,6 +61,23 @@ for i = 1:r
 
     if scan
         metadata.completed = false;
+        metadata.pending(end+1) = i;
+        continue;
+    end;
+
+    context.repetition = i;
+
+    % Repetitions after the third one are only known to be needed when the
+    % first three are completed
+    if defer
+        if i > 3 && any(cellfun(@(task) task.repetition <= 3, metadata.tasks))
+            break;
+        end;
+        metadata.tasks{end+1} = struct('name', sprintf('%s, repetition %d', sequence.name, i), ...
+            'repetition', i, 'directory', directory, 'sequence', sequence.name, ...
+            'prepare', @() prepare_repetition(sequence, context), ...
+            'callback', @callback, 'finish', @(data) finish_repetition(data, result_file, directory, time_file), ...
+            'abort', @abort_repetition);
         continue;
     end;
 
@@ -63,33 +85,17 @@ for i = 1:r
 
     print_text('Repetition %d', i);
 
-    context.repetition = i;
+    data = prepare_repetition(sequence, context);
 
-    data.sequence = sequence;
-    data.bounds = [sequence.width, sequence.height] - 1;
-    data.index = 1;
-    data.context = context;
-    data.time = 0;
+    try
+        data = tracker_run(tracker, @callback, data);
+    catch e
+        abort_repetition(data);
+        rethrow(e);
+    end;
 
-    if isfield(sequence.properties, 'fps') && ~context.override_fps
-        data.fps = sequence.properties.fps;
-    else
-        data.fps = context.default_fps;
-    end
+    times = finish_repetition(data, result_file, directory, time_file, times);
 
-    data.result = repmat({0}, sequence.length, 1);
-    data.timing = nan(sequence.length, 1);
-    data.initialized = false;
-    data.properties = properties_create(sequence);
-    data.channels = {};
-    
-    data = tracker_run(tracker, @callback, data);
-
-    times(:, i) = data.timing;
-    write_trajectory(result_file, data.result);
-    csvwrite(time_file, times);
-    properties_save(directory, sprintf('%s_%03d', sequence.name, i), data.properties);
-    
     files{end+1} = result_file; %#ok<AGROW>
     values = dir(fullfile(directory, sprintf('%s_%03d_*.value', sequence.name, i)));
     files(end+1:end+length(values)) = cellfun(@(x) fullfile(directory, x.name), num2cell(values), 'UniformOutput', false);
@@ -105,6 +111,64 @@ end;
 
 end
 
+function data = prepare_repetition(sequence, context)
+
+data.sequence = sequence;
+data.bounds = [sequence.width, sequence.height] - 1;
+data.index = 1;
+data.context = context;
+data.time = 0;
+
+if isfield(sequence.properties, 'fps') && ~context.override_fps
+    data.fps = sequence.properties.fps;
+else
+    data.fps = context.default_fps;
+end
+
+data.result = repmat({0}, sequence.length, 1);
+data.timing = nan(sequence.length, 1);
+data.initialized = false;
+data.properties = properties_create(sequence);
+data.channels = {};
+data.prefetch = [];
+data.overlap = sequence_overlap_session(sequence, data.bounds);
+
+end
+
+function times = finish_repetition(data, result_file, directory, time_file, times)
+
+% A deferred repetition is finished after other repetitions have updated the timing file
+if nargin < 5
+    times = zeros(data.sequence.length, data.context.repetitions);
+    if exist(time_file, 'file')
+        times = csvread(time_file);
+    end;
+end;
+
+region_overlap('close', data.overlap);
+
+if ~isempty(data.prefetch)
+    statistics = frame_prefetch('close', data.prefetch);
+    print_text('Prefetched images: %d hits, %d misses', statistics.hits, statistics.misses);
+end;
+
+times(:, data.context.repetition) = data.timing;
+write_trajectory(result_file, data.result);
+csvwrite(time_file, times);
+properties_save(directory, sprintf('%s_%03d', data.sequence.name, data.context.repetition), data.properties);
+
+end
+
+function abort_repetition(data)
+
+region_overlap('close', data.overlap);
+
+if ~isempty(data.prefetch)
+    frame_prefetch('close', data.prefetch);
+end;
+
+end
+
 function [image, region, properties, data] = callback(state, data)
 
 region = [];
@@ -116,12 +180,13 @@ if isempty(data.channels)
         error('Sequence does not contain all channels required by the tracker.');
     end;
     data.channels = state.channels;
+    data.prefetch = sequence_prefetch(data.sequence, data.channels);
 end;
 
 % Handle initial frame (initialize for the first time)
 if isempty(state.region)
     region = data.sequence.initialize(data.sequence, data.index, data.context);
-    image = sequence_get_image(data.sequence, data.index, data.channels);
+    image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
     data.time = 0;
 	data.offset = 0;
     data.grace = data.context.grace;
@@ -155,7 +220,7 @@ else
         %        and the state.region used to update this model
 
         for i = previous:min(data.sequence.length, current-1)
-            o = region_overlap(data.region, sequence_get_region(data.sequence, i), data.bounds);
+            o = region_overlap('query', data.overlap, data.region, i);
             if o(1) <= data.context.failure_overlap
                 failed = i;
                 break;
@@ -164,7 +229,7 @@ else
         end
 
         if current <= data.sequence.length
-            o = region_overlap(state.region, sequence_get_region(data.sequence, current), data.bounds);
+            o = region_overlap('query', data.overlap, state.region, current);
             if o(1) <= data.context.failure_overlap
                 failed = current;
             else
@@ -172,7 +237,7 @@ else
             end
         end
     else   % realtime_type = 'delayed' by default
-        o = region_overlap(state.region, sequence_get_region(data.sequence, previous), data.bounds);
+        o = region_overlap('query', data.overlap, state.region, previous);
         if o(1) <= data.context.failure_overlap
             failed = previous;
         else
@@ -215,7 +280,7 @@ else
 
 end
 
-image = sequence_get_image(data.sequence, data.index, data.channels);
+image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
 
 end
 
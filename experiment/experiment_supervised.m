@@ -1,7 +1,13 @@
-function [files, metadata] = experiment_supervised(tracker, sequence, directory, parameters, scan)
+function [files, metadata] = experiment_supervised(tracker, sequence, directory, parameters, scan, defer)
+
+if nargin < 6
+    defer = false;
+end;
 
 files = {};
 metadata.completed = true;
+metadata.pending = [];
+metadata.tasks = {};
 cache = get_global_variable('experiment_cache', true);
 silent = get_global_variable('experiment_silent', false);
 
@@ -13,14 +19,6 @@ if context.failure_overlap < 0
     error('Illegal failure overlap');
 end;
 
-time_file = fullfile(directory, sprintf('%s_time.txt', sequence.name));
-
-times = zeros(sequence.length, context.repetitions);
-
-if ~scan && cache && exist(time_file, 'file')
-    times = csvread(time_file);
-end;
-
 r = context.repetitions;
 
 if isfield(tracker, 'metadata') && isfield(tracker.metadata, 'deterministic') && tracker.metadata.deterministic
@@ -29,8 +27,15 @@ end
 
 check_deterministic = ~(scan && nargout < 2); % Ensure faster execution when we only want a list of files by ommiting determinisim check.
 
+[times, time_file, worker_repetition] = experiment_workers(mfilename, tracker, sequence, directory, parameters, ...
+    context.repetitions, r, scan, cache, defer);
+
 for i = 1:r
 
+    if ~isempty(worker_repetition) && i ~= worker_repetition
+        continue;
+    end;
+
     result_file = fullfile(directory, sprintf('%s_%03d.txt', sequence.name, i));
 
     if cache && exist(result_file, 'file')
@@ -40,7 +45,7 @@ for i = 1:r
         continue;
     end;
 
-    if check_deterministic && i == 4 && is_deterministic(sequence, 3, directory)
+    if check_deterministic && (i == 4 || (~isempty(worker_repetition) && i > 4)) && is_deterministic(sequence, 3, directory)
         if ~silent
             print_debug('Detected a deterministic tracker, skipping remaining trials.');
         end;
@@ -50,6 +55,23 @@ for i = 1:r
 
     if scan
         metadata.completed = false;
+        metadata.pending(end+1) = i;
+        continue;
+    end;
+
+    context.repetition = i;
+
+    % Repetitions after the third one are only known to be needed when the
+    % first three are completed
+    if defer
+        if i > 3 && any(cellfun(@(task) task.repetition <= 3, metadata.tasks))
+            break;
+        end;
+        metadata.tasks{end+1} = struct('name', sprintf('%s, repetition %d', sequence.name, i), ...
+            'repetition', i, 'directory', directory, 'sequence', sequence.name, ...
+            'prepare', @() prepare_repetition(sequence, context, result_file, cache), ...
+            'callback', @callback, 'finish', @(data) finish_repetition(data, directory, time_file), ...
+            'abort', @abort_repetition);
         continue;
     end;
 
@@ -57,25 +79,16 @@ for i = 1:r
 
     print_text('Repetition %d', i);
 
-    context.repetition = i;
+    data = prepare_repetition(sequence, context, result_file, cache);
 
-    data.sequence = sequence;
-    data.index = 1;
-    data.context = context;
-    data.bounds = [sequence.width, sequence.height] - 1;
-    data.result = repmat({0}, sequence.length, 1);
-    data.timing = nan(sequence.length, 1);
-    data.initialized = false;
-    data.properties = properties_create(sequence);
-    data.channels = {};
-    
-    data = tracker_run(tracker, @callback, data);
-
-    times(:, i) = data.timing;
-    write_trajectory(result_file, data.result);
-    csvwrite(time_file, times);
+    try
+        data = tracker_run(tracker, @callback, data);
+    catch e
+        abort_repetition(data);
+        rethrow(e);
+    end;
 
-    properties_save(directory, sprintf('%s_%03d', sequence.name, i), data.properties);
+    times = finish_repetition(data, directory, time_file, times);
 
     files{end+1} = result_file; %#ok<AGROW>
     values = dir(fullfile(directory, sprintf('%s_%03d_*.value', sequence.name, i)));
@@ -92,6 +105,103 @@ end;
 
 end
 
+function data = prepare_repetition(sequence, context, result_file, cache)
+
+data.sequence = sequence;
+data.index = 1;
+data.context = context;
+data.bounds = [sequence.width, sequence.height] - 1;
+data.result = repmat({0}, sequence.length, 1);
+data.timing = nan(sequence.length, 1);
+data.initialized = false;
+data.properties = properties_create(sequence);
+data.channels = {};
+data.prefetch = [];
+data.overlap = sequence_overlap_session(sequence, data.bounds);
+
+% Frames are streamed to a partial file, an interrupted repetition is
+% resumed from the last initialization that was written. The timing of the
+% written frames is kept in its own partial file and the properties are
+% saved at every failure, a repetition is only resumed if the timing and
+% the properties of all frames before the initialization are known.
+[data.writer, existing] = write_trajectory('open', result_file, get_global_variable('trajectory_flush', 10));
+data.timing_file = [result_file, '.time'];
+data.properties_file = [result_file, '.properties'];
+data.written = 0;
+
+start = [];
+if cache
+    start = find(cellfun(@(x) isnumeric(x) && numel(x) == 1 && x == 1, existing), 1, 'last');
+end;
+
+if ~isempty(start) && start <= sequence.length
+    timing = read_timing(data.timing_file);
+    [properties, frames] = read_properties(data.properties_file);
+    if numel(timing) >= start - 1 && frames >= start - 1
+        print_debug('Resuming repetition from frame %d', start);
+        data.result(1:start-1) = existing(1:start-1);
+        data.timing(1:start-1) = timing(1:start-1);
+        data.properties.names = properties.names;
+        data.properties.data = cell(sequence.length, numel(properties.names));
+        data.properties.data(1:start-1, :) = properties.data(1:start-1, :);
+        data.index = start;
+        data.written = start - 1;
+    else
+        print_debug('Timing or properties of the interrupted repetition are not available, restarting');
+    end;
+end;
+
+write_trajectory('truncate', data.writer, data.written);
+write_timing(data.timing_file, data.timing(1:data.written), 'w');
+write_properties(data.properties_file, data.properties, data.written);
+
+end
+
+function times = finish_repetition(data, directory, time_file, times)
+
+% A deferred repetition is finished after other repetitions have updated the timing file
+if nargin < 4
+    times = zeros(data.sequence.length, data.context.repetitions);
+    if exist(time_file, 'file')
+        times = csvread(time_file);
+    end;
+end;
+
+region_overlap('close', data.overlap);
+
+if ~isempty(data.prefetch)
+    statistics = frame_prefetch('close', data.prefetch);
+    print_text('Prefetched images: %d hits, %d misses', statistics.hits, statistics.misses);
+end;
+
+times(:, data.context.repetition) = data.timing;
+write_trajectory('append', data.writer, data.result(data.written+1:end));
+write_trajectory('close', data.writer);
+csvwrite(time_file, times);
+
+if exist(data.timing_file, 'file')
+    delete(data.timing_file);
+end;
+
+if exist(data.properties_file, 'file')
+    delete(data.properties_file);
+end;
+
+properties_save(directory, sprintf('%s_%03d', data.sequence.name, data.context.repetition), data.properties);
+
+end
+
+function abort_repetition(data)
+
+write_trajectory('abort', data.writer);
+region_overlap('close', data.overlap);
+
+if ~isempty(data.prefetch)
+    frame_prefetch('close', data.prefetch);
+end;
+
+end
+
 function [image, region, properties, data] = callback(state, data)
 
 region = [];
@@ -103,15 +213,16 @@ if isempty(data.channels)
         error('Sequence does not contain all channels required by the tracker.');
     end;
     data.channels = state.channels;
+    data.prefetch = sequence_prefetch(data.sequence, data.channels);
 end;
 
 % Handle initial frame (initialize for the first time)
 if isempty(state.region)
     region = data.sequence.initialize(data.sequence, data.index, data.context);
-    image = sequence_get_image(data.sequence, data.index, data.channels);
+    image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
     return;
 end;
-o = region_overlap(state.region, sequence_get_region(data.sequence, data.index), data.bounds);
+o = region_overlap('query', data.overlap, state.region, data.index);
 
 % Handle tracker failure
 if o(1) <= data.context.failure_overlap
@@ -133,12 +244,18 @@ if o(1) <= data.context.failure_overlap
 		data.index = start;
     end;
 
+    data = stream_result(data);
+
+    % A resumed repetition starts at the next initialization and needs the
+    % properties of all frames before it
+    write_properties(data.properties_file, data.properties, data.written);
+
     if data.index > data.sequence.length
         return;
     end
 
     region = data.sequence.initialize(data.sequence, data.index, data.context);
-    image = sequence_get_image(data.sequence, data.index, data.channels);
+    image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
     data.initialized = false;
     return;
 end;
@@ -155,12 +272,81 @@ data.properties = properties_set(data.properties, data.index, state.properties);
 
 data.index = data.index + 1;
 
+data = stream_result(data);
+
 % End of sequence
 if data.index > data.sequence.length
     return;
 end
 
-image = sequence_get_image(data.sequence, data.index, data.channels);
+image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
+
+end
+
+function data = stream_result(data)
+
+% Frames before the current position are final and can be written
+last = min(data.index - 1, data.sequence.length);
+
+if last > data.written
+    write_trajectory('append', data.writer, data.result(data.written+1:last));
+    write_timing(data.timing_file, data.timing(data.written+1:last), 'a');
+    data.written = last;
+end;
+
+end
+
+function timing = read_timing(timing_file)
+
+timing = [];
+
+fid = fopen(timing_file, 'r');
+
+if fid < 0
+    return;
+end;
+
+timing = fscanf(fid, '%f');
+
+fclose(fid);
+
+end
+
+function [properties, frames] = read_properties(properties_file)
+
+properties = [];
+frames = -1;
+
+if ~exist(properties_file, 'file')
+    return;
+end;
+
+try
+    saved = load(properties_file, '-mat');
+    properties = saved.properties;
+    frames = saved.frames;
+catch
+    frames = -1;
+end;
+
+end
+
+function write_properties(properties_file, properties, frames)
+
+save(properties_file, 'properties', 'frames', '-mat');
 
 end
 
+function write_timing(timing_file, timing, mode)
+
+fid = fopen(timing_file, mode);
+
+if fid < 0
+    error('Unable to write timing file %s', timing_file);
+end;
+
+fprintf(fid, '%.9g\n', timing);
+
+fclose(fid);
+
+end
@@ -1,7 +1,13 @@
-function [files, metadata] = experiment_unsupervised(tracker, sequence, directory, parameters, scan)
+function [files, metadata] = experiment_unsupervised(tracker, sequence, directory, parameters, scan, defer)
+
+    if nargin < 6
+        defer = false;
+    end;
 
     files = {};
     metadata.completed = true;
+    metadata.pending = [];
+    metadata.tasks = {};
 	cache = get_global_variable('experiment_cache', true);
 	silent = get_global_variable('experiment_silent', false);
 
@@ -9,14 +15,6 @@ function [files, metadata] = experiment_unsupervised(tracker, sequence, director
     context = struct_merge(parameters, defaults);
     metadata.deterministic = false;
 
-    time_file = fullfile(directory, sprintf('%s_time.txt', sequence.name));
-
-    times = zeros(sequence.length, context.repetitions);
-
-    if ~scan && cache && exist(time_file, 'file')
-        times = csvread(time_file);
-    end;
-
 	r = context.repetitions;
 
 	if isfield(tracker, 'metadata') && isfield(tracker.metadata, 'deterministic') && tracker.metadata.deterministic
@@ -25,8 +23,15 @@ function [files, metadata] = experiment_unsupervised(tracker, sequence, director
 
 	check_deterministic = ~(scan && nargout < 2); % Ensure faster execution when we only want a list of files by ommiting determinisim check.
 
+    [times, time_file, worker_repetition] = experiment_workers(mfilename, tracker, sequence, directory, parameters, ...
+        context.repetitions, r, scan, cache, defer);
+
     for i = 1:r
 
+        if ~isempty(worker_repetition) && i ~= worker_repetition
+            continue;
+        end;
+
         result_file = fullfile(directory, sprintf('%s_%03d.txt', sequence.name, i));
 
         if cache && exist(result_file, 'file')
@@ -36,7 +41,7 @@ function [files, metadata] = experiment_unsupervised(tracker, sequence, director
             continue;
         end;
 
-        if check_deterministic && i == 4 && is_deterministic(sequence, 3, directory)
+        if check_deterministic && (i == 4 || (~isempty(worker_repetition) && i > 4)) && is_deterministic(sequence, 3, directory)
             if ~silent
                 print_debug('Detected a deterministic tracker, skipping remaining trials.');
             end;
@@ -46,6 +51,23 @@ function [files, metadata] = experiment_unsupervised(tracker, sequence, director
 
         if scan
             metadata.completed = false;
+            metadata.pending(end+1) = i;
+            continue;
+        end;
+
+        context.repetition = i;
+
+        % Repetitions after the third one are only known to be needed when the
+        % first three are completed
+        if defer
+            if i > 3 && any(cellfun(@(task) task.repetition <= 3, metadata.tasks))
+                break;
+            end;
+            metadata.tasks{end+1} = struct('name', sprintf('%s, repetition %d', sequence.name, i), ...
+                'repetition', i, 'directory', directory, 'sequence', sequence.name, ...
+                'prepare', @() prepare_repetition(sequence, context), ...
+                'callback', @callback, 'finish', @(data) finish_repetition(data, result_file, directory, time_file), ...
+                'abort', @abort_repetition);
             continue;
         end;
 
@@ -53,23 +75,11 @@ function [files, metadata] = experiment_unsupervised(tracker, sequence, director
 
         print_text('Repetition %d', i);
 
-        context.repetition = i;
-
-		data.sequence = sequence;
-		data.index = 1;
-		data.context = context;
-		data.result = repmat({0}, sequence.length, 1);
-		data.timing = nan(sequence.length, 1);
-        data.properties = properties_create(sequence);
-        data.channels = {};
+        data = prepare_repetition(sequence, context);
 
 		data = tracker_run(tracker, @callback, data);
 
-	    times(:, i) = data.timing;
-	    write_trajectory(result_file, data.result);
-		csvwrite(time_file, times);
-
-        properties_save(directory, sprintf('%s_%03d', sequence.name, i), data.properties);
+        times = finish_repetition(data, result_file, directory, time_file, times);
 
         files{end+1} = result_file; %#ok<AGROW>
         values = dir(fullfile(directory, sprintf('%s_%03d_*.value', sequence.name, i)));
@@ -87,6 +97,50 @@ function [files, metadata] = experiment_unsupervised(tracker, sequence, director
 
 end
 
+function data = prepare_repetition(sequence, context)
+
+	data.sequence = sequence;
+	data.index = 1;
+	data.context = context;
+	data.result = repmat({0}, sequence.length, 1);
+	data.timing = nan(sequence.length, 1);
+    data.properties = properties_create(sequence);
+    data.channels = {};
+    data.prefetch = [];
+
+end
+
+function times = finish_repetition(data, result_file, directory, time_file, times)
+
+    % A deferred repetition is finished after other repetitions have updated the timing file
+    if nargin < 5
+        times = zeros(data.sequence.length, data.context.repetitions);
+        if exist(time_file, 'file')
+            times = csvread(time_file);
+        end;
+    end;
+
+    if ~isempty(data.prefetch)
+        statistics = frame_prefetch('close', data.prefetch);
+        print_text('Prefetched images: %d hits, %d misses', statistics.hits, statistics.misses);
+    end;
+
+    times(:, data.context.repetition) = data.timing;
+    write_trajectory(result_file, data.result);
+    csvwrite(time_file, times);
+
+    properties_save(directory, sprintf('%s_%03d', data.sequence.name, data.context.repetition), data.properties);
+
+end
+
+function abort_repetition(data)
+
+    if ~isempty(data.prefetch)
+        frame_prefetch('close', data.prefetch);
+    end;
+
+end
+
 function [image, region, properties, data] = callback(state, data)
 
 	region = [];
@@ -98,12 +152,13 @@ function [image, region, properties, data] = callback(state, data)
             error('Sequence does not contain all channels required by the tracker.');
         end;
         data.channels = state.channels;
+        data.prefetch = sequence_prefetch(data.sequence, data.channels);
     end;
     
 	% Handle initial frame (initialize for the first time)
 	if isempty(state.region)
 		region = data.sequence.initialize(data.sequence, data.index, data.context);
-		image = sequence_get_image(data.sequence, data.index, data.channels);
+		image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
 		return;
 	end;
 
@@ -124,7 +179,7 @@ function [image, region, properties, data] = callback(state, data)
 		return;
 	end
 
-    image = sequence_get_image(data.sequence, data.index, data.channels);
+    image = sequence_get_image(data.sequence, data.index, data.channels, data.prefetch);
 
 end
 
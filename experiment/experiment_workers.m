@@ -0,0 +1,52 @@
+function [times, time_file, worker_repetition] = experiment_workers(experiment_function, tracker, sequence, directory, parameters, repetitions, runs, scan, cache, defer)
+% experiment_workers Prepare the timing of an experiment and run its repetitions concurrently
+%
+% Loads the timing matrix of an experiment for a tracker and a sequence and, if
+% the global variable experiment_concurrency allows it, runs the missing
+% repetitions in worker processes (see experiment_concurrent). A worker process
+% runs a single repetition (set by the global variable experiment_repetition)
+% and keeps its timing in a separate file that is merged into the timing file
+% of the experiment by the process that started it (see experiment_merge_timing).
+%
+% Input:
+% - experiment_function (string): Name of the experiment function.
+% - tracker (structure): A valid tracker descriptor.
+% - sequence (structure): A valid sequence descriptor.
+% - directory (string): Directory of the results.
+% - parameters (structure): Parameters of the experiment.
+% - repetitions (integer): Number of columns of the timing matrix.
+% - runs (integer): Number of repetitions that are run for the tracker.
+% - scan (boolean): Only the list of files is requested, nothing is run.
+% - cache (boolean): Existing results are reused.
+% - defer (boolean): Repetitions are returned as tasks instead of being run.
+%
+% Output:
+% - times (matrix): Timing matrix of the experiment.
+% - time_file (string): Path to the timing file of the experiment or of the worker.
+% - worker_repetition (integer): Repetition of the worker, empty in the main process.
+%
+
+time_file = fullfile(directory, sprintf('%s_time.txt', sequence.name));
+
+worker_repetition = get_global_variable('experiment_repetition', []);
+if ~isempty(worker_repetition)
+    time_file = fullfile(directory, sprintf('%s_%03d_time.part', sequence.name, worker_repetition));
+end;
+
+times = zeros(sequence.length, repetitions);
+
+if ~scan && cache && exist(time_file, 'file')
+    times = csvread(time_file);
+end;
+
+if scan || ~isempty(worker_repetition)
+    return;
+end;
+
+times = experiment_merge_timing(sequence, directory, times, time_file);
+
+if ~defer && cache && get_global_variable('experiment_concurrency', 1) ~= 1 && ~ispc()
+    times = experiment_concurrent(experiment_function, tracker, sequence, directory, parameters, runs, times, time_file);
+end;
+
+end
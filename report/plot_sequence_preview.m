@@ -68,6 +68,16 @@ indices = round(linspace(1, sequence.length, samples));
 
 animation = zeros(ceil(sequence.height * scale), ceil(sequence.width * scale), numel(indices), 3);
 
+% Regions of all sampled frames are converted to polygons at once, frames that
+% can not be converted become rows of NaN values
+polygons = cell(length(trajectories), 1);
+
+for t = 1:length(trajectories)
+    polygons{t} = region_convert(trajectories{t}(indices, :), 'polygon', true);
+end;
+
+groundtruth = region_convert(sequence.groundtruth(indices), 'polygon');
+
 for i = 1:length(indices)
 
     image = double(imread(sequence_get_image(sequence, indices(i)))) / 255;
@@ -84,13 +94,14 @@ for i = 1:length(indices)
 
     for t = 1:length(trajectories)
 
-        region = trajectories{t}(indices(i), :);
+        region = polygons{t}(i, :);
+        region = region(~isnan(region));
 
-        if any(isnan(region))
+        if numel(region) < 6
             continue;
         end;
 
-        region = region_convert(region, 'polygon') .* scale;
+        region = region .* scale;
 
         rasterized = edge(poly2mask(region(1:2:end), region(2:2:end), size(image, 1), size(image, 2)), 'canny');
 
@@ -102,9 +113,7 @@ for i = 1:length(indices)
 
     if ~isempty(groundtruth_color)
 
-        region = sequence_get_region(sequence, indices(i));
-
-        region = region_convert(region, 'polygon') .* scale;
+        region = groundtruth{i} .* scale;
 
         rasterized = edge(poly2mask(region(1:2:end), region(2:2:end), size(image, 1), size(image, 2)), 'canny');
 
@@ -71,6 +71,17 @@ else
 end;
 handles = tight_subplots(1, length(indices), 0, 0, 0);
 
+% Bounding boxes of all sampled frames are computed at once
+if ~isinf(window)
+    windows = region_convert(sequence.groundtruth(indices), 'rectangle');
+end;
+
+if ~isempty(trajectories_markers)
+    % Frames that can not be converted are left empty and skipped when drawn
+    markers = cellfun(@(trajectory) region_convert(trajectory(indices), 'rectangle', true), ...
+        trajectories, 'UniformOutput', false);
+end;
+
 for i = 1:length(indices)
 
 	if isinf(window)
@@ -83,7 +94,7 @@ for i = 1:length(indices)
 
 	    patch = zeros(window, window, 3);
 
-		region = region_convert(sequence_get_region(sequence, indices(i)), 'rectangle');
+		region = windows{i};
 
 		offset = region(1:2) + (region(3:4) - window) / 2;
 
@@ -118,8 +129,13 @@ for i = 1:length(indices)
         region_draw(region, trajectories_colors{t}, 2);
 
         if ~isempty(trajectories_markers)
-            bounds = region_convert(region, 'rectangle');
-            center = bounds(1:2) + bounds(3:4) / 2;
+            bounds = markers{t}{i};
+
+            if numel(bounds) < 4
+                continue;
+            end;
+
+            center = bounds(1:2) - offset + bounds(3:4) / 2;
 
             plot(center(1), center(2), trajectories_markers{t}, 'MarkerSize', 7, 'LineWidth', 1.5, 'Color', trajectories_colors{t});
 
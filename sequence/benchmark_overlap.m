@@ -0,0 +1,89 @@
+function results = benchmark_overlap(varargin)
+% benchmark_overlap Compare region overlap modes for different resolutions
+%
+% Measures the time that region_overlap needs to compute the overlap for a batch
+% of rotated rectangles using the legacy and default rasterization and the exact
+% geometric mode. Regions are scaled together with the image so that they cover
+% a similar portion of the image at every resolution, which shows how the cost of
+% each mode grows with the number of pixels covered by the regions.
+%
+% Input:
+% - varargin[Resolutions] (matrix): An N x 2 matrix of image sizes (width, height).
+% - varargin[Pairs] (integer): Number of region pairs in a batch.
+% - varargin[Repetitions] (integer): Number of timed repetitions for every batch.
+%
+% Output:
+% - results (structure): A structure with fields resolutions, modes and times, where
+%   times is a matrix of average times per region pair (in seconds) with a row for
+%   every resolution and a column for every mode.
+%
+
+resolutions = [320, 240; 640, 480; 1280, 720; 1920, 1080; 3840, 2160];
+pairs = 1000;
+repetitions = 5;
+
+args = varargin;
+for j=1:2:length(args)
+    switch lower(varargin{j})
+        case 'resolutions', resolutions = args{j+1};
+        case 'pairs', pairs = max(1, args{j+1});
+        case 'repetitions', repetitions = max(1, args{j+1});
+        otherwise, error(['unrecognized argument ' args{j}]);
+    end
+end
+
+modes = {'legacy', 'default', 'exact'};
+
+times = nan(size(resolutions, 1), numel(modes));
+
+print_text('Benchmarking region overlap (%d pairs, %d repetitions)', pairs, repetitions);
+
+print_indent(1);
+
+for r = 1:size(resolutions, 1)
+
+    width = resolutions(r, 1);
+    height = resolutions(r, 2);
+
+    regions1 = random_regions(pairs, width, height);
+    regions2 = cellfun(@(x) region_offset(x, [width, height] .* (rand(1, 2) - 0.5) * 0.1), ...
+        random_regions(pairs, width, height), 'UniformOutput', false);
+    regions2 = cellfun(@(x, y) (x + y) / 2, regions1, regions2, 'UniformOutput', false);
+
+    bounds = [width, height] - 1;
+
+    for m = 1:numel(modes)
+        tic;
+        for i = 1:repetitions
+            region_overlap(regions1, regions2, bounds, modes{m});
+        end;
+        times(r, m) = toc / (repetitions * pairs);
+    end;
+
+    print_text('%d x %d: %s', width, height, strjoin(cellfun(@(mode, time) ...
+        sprintf('%s %.2f us', mode, time * 1e6), modes, num2cell(times(r, :)), ...
+        'UniformOutput', false), ', '));
+
+end;
+
+print_indent(-1);
+
+results = struct('resolutions', resolutions, 'modes', {modes}, 'times', times);
+
+end
+
+function regions = random_regions(count, width, height)
+
+regions = cell(count, 1);
+
+for i = 1:count
+    center = [width, height] .* (0.3 + rand(1, 2) * 0.4);
+    extent = [width, height] .* (0.05 + rand(1, 2) * 0.2);
+    angle = rand() * pi;
+    rotation = [cos(angle), -sin(angle); sin(angle), cos(angle)];
+    corners = [-1, -1; 1, -1; 1, 1; -1, 1] .* repmat(extent, 4, 1) * rotation';
+    corners = corners + repmat(center, 4, 1);
+    regions{i} = reshape(corners', 1, 8);
+end;
+
+end
@@ -1,4 +1,4 @@
-function [overlap, only1, only2] = calculate_overlap(T1, T2, bounds)
+function [overlap, only1, only2] = calculate_overlap(T1, T2, bounds, types1, types2)
 % calculate_overlap  Calculates overlap for two trajectories
 %
 % The function calculates per-frame overlap between two trajectories. Besides the
@@ -9,38 +9,62 @@ function [overlap, only1, only2] = calculate_overlap(T1, T2, bounds)
 % to the end of the shorter one.
 %
 % Input:
-% - T1 (cell): The first trajectory.
-% - T2 (cell): The second trajectory.
+% - T1 (cell, matrix): The first trajectory, either a cell array of regions or a
+%   matrix with one region per row (padded with NaN values for polygons of different size).
+% - T2 (cell, matrix, structure): The second trajectory or a sequence structure. If a
+%   sequence is given, its groundtruth is used and the rasterized groundtruth is cached
+%   (see sequence_overlap_session).
 % - bounds (vector): An optional bounds of valid region where the overlap is calculated.
+% - types1 (vector): Optional region type codes of the first trajectory (see read_trajectory),
+%   required to tell masks apart from polygons in a matrix.
+% - types2 (vector): Optional region type codes of the second trajectory.
 %
 % Output:
 % - overlap: A vector of per-frame overlaps.
 % - only1: A vector of per-frame containment of the second trajectory in the first.
 % - only2: A vector of per-frame containment of the first trajectory in the second.
 
-len = min(size(T1, 1), size(T2, 1));
-T1 = T1(1:len, :);
-T2 = T2(1:len, :);
-
-if (~iscell(T1)) 
-    T1 = num2cell(T1, 2); 
-end 
+if isstruct(T2)
+    len = min(size(T1, 1), T2.length);
+else
+    len = min(size(T1, 1), size(T2, 1));
+    T2 = T2(1:len, :);
+end;
 
-if (~iscell(T2)) 
-    T2 = num2cell(T2, 2); 
-end 
+T1 = T1(1:len, :);
 
 if nargin < 3
     bounds = [];
 end
 
-if get_global_variable('legacy_rasterization', true)
+if nargin < 5
+    types1 = [];
+    types2 = [];
+else
+    types1 = types1(1:len);
+    types2 = types2(1:len);
+end
+
+if get_global_variable('exact_overlap', false)
+    mode = 'exact';
+elseif get_global_variable('legacy_rasterization', true)
     mode = 'legacy';
 else
     mode = 'default';
 end;
 
-results = region_overlap(T1, T2, bounds, mode);
+if isstruct(T2)
+    session = sequence_overlap_session(T2, bounds, mode);
+    try
+        results = region_overlap('query', session, T1, [], get_global_variable('native_threads', 0));
+    catch e
+        region_overlap('close', session);
+        rethrow(e);
+    end;
+    region_overlap('close', session);
+else
+    results = region_overlap(T1, T2, bounds, mode, get_global_variable('native_threads', 0), types1, types2);
+end;
 
 %results = cell2mat(cellfun(@(r1, r2) region_overlap(r1, r2), T1, T2, 'UniformOutput', false));
 
@@ -5,6 +5,11 @@ function tranform_sequence = sequence_transform_initialization(sequence, transfo
 % transforms the region before handing it over to the tracker. This can be used to 
 % to introduce noise.
 %
+% The transformation function is called with the sequence, the frame index and the
+% experiment context and returns a 3x3 transformation matrix that is applied around
+% the center of the region. A function that accepts a fourth argument also gets the
+% bounding box of the initialization region.
+%
 % Input:
 % - sequence (structure): A valid sequence structure.
 % - transform (function): A handle of transformation function.
@@ -22,20 +27,35 @@ tranform_sequence.initialize = @transform_initialization;
 tranform_sequence.initialize_transform = transform;
 tranform_sequence.initialize_format = format;
 
+% Regions of all frames are converted at once, initialization only looks them
+% up. Frames that cannot be converted are left empty and only fail when they
+% are used for initialization.
+tranform_sequence.initialize_bounds = region_convert(sequence.groundtruth, 'rectangle', true);
+tranform_sequence.initialize_polygons = region_convert(sequence.groundtruth, 'polygon', true);
+
 end
 
 function [region] = transform_initialization(sequence, index, context)
         
     region = sequence_get_region(sequence, index);
 
-    transform = sequence.initialize_transform(sequence, index, context);
+    bounds = sequence.initialize_bounds{index};
+
+    if isempty(bounds)
+        bounds = region_convert(region, 'rectangle');
+    end;
+
+    % Only transformations that accept it get the bounding box
+    if nargin(sequence.initialize_transform) > 3 || nargin(sequence.initialize_transform) < 0
+        transform = sequence.initialize_transform(sequence, index, context, bounds);
+    else
+        transform = sequence.initialize_transform(sequence, index, context);
+    end;
     
     if size(transform, 1) ~= 3 || size(transform, 2) ~= 3
         return;
     end;
 
-    bounds = region_convert(region, 'rectangle');
-    
     origin = bounds(1:2) + bounds(3:4) / 2;
     
     shift = [1, 0, origin(1); 0, 1, origin(2); 0, 0, 1];
@@ -43,7 +63,11 @@ function [region] = transform_initialization(sequence, index, context)
     transform = shift * transform / shift;
 
     if isnumeric(region) 
-        polygon = region_convert(region, 'polygon');
+        polygon = sequence.initialize_polygons{index};
+
+        if isempty(polygon)
+            polygon = region_convert(region, 'polygon');
+        end;
 
         region = cat(2, reshape(polygon, 2, numel(polygon) / 2)', ...
             ones(numel(polygon) / 2 , 1));
@@ -0,0 +1,423 @@
+
+// Prefetches the images of a sequence ahead of the tracker. A background
+// thread warms the page cache for the next frames while the current frame is
+// being tracked, so that reading an image from a slow (e.g. network) file
+// system is not measured as tracker time.
+//
+// prefetch = frame_prefetch('open', files, depth, mode)
+//
+// Files is a cell array of image paths with a row for every channel and a
+// column for every frame (the output of sequence_get_image for a vector of
+// frames), depth is the number of frames that are prefetched ahead of the
+// current one (zero only counts hits and misses). In the 'advise' mode (the
+// default) the kernel is asked to read the files with posix_fadvise and
+// readahead, the 'read' mode reads the files in the background thread, which
+// also works where the advice is ignored.
+//
+// frame_prefetch('advance', prefetch, frame)
+//
+// Tells the prefetcher that the images of a frame are about to be read, the
+// frame is counted as a hit if all of its files are in the page cache and the
+// prefetch window moves to the frames after it. An empty prefetcher is ignored.
+//
+// statistics = frame_prefetch('close', prefetch)
+//
+// Stops the prefetcher and returns a structure with the number of hits and
+// misses, the number of prefetched frames and their size in bytes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#include "mex.h"
+
+#if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER)
+#define strcmpi _strcmpi
+#else
+#define strcmpi strcasecmp
+#endif
+
+using namespace std;
+
+#define PREFETCH_BUFFER (1 << 20)
+
+typedef enum prefetch_mode { PREFETCH_ADVISE, PREFETCH_READ } prefetch_mode;
+
+char* getString(const mxArray *arg) {
+
+	if (!mxIsChar(arg) || mxGetM(arg) > 1)
+		mexErrMsgTxt("Must be a string");
+
+    int l = (int) mxGetN(arg);
+
+    char* str = (char *) malloc(sizeof(char) * (l + 1));
+
+    mxGetString(arg, str, (l + 1));
+
+    return str;
+}
+
+int getSingleInteger(const mxArray *arg) {
+
+	if (mxGetM(arg) != 1 || mxGetN(arg) != 1)
+		mexErrMsgTxt("Parameter must be a single value");
+
+    if (mxIsInt32(arg))
+        return ((int*)mxGetPr(arg))[0];
+
+    if (mxIsDouble(arg))
+        return (int) ((double*)mxGetPr(arg))[0];
+
+    return 0;
+}
+
+// Reads a file in the given mode, returns the number of bytes or zero if the
+// file cannot be opened.
+size_t prefetchFile(const string& path, prefetch_mode mode) {
+
+#if !defined(_WIN32)
+    if (mode == PREFETCH_ADVISE) {
+
+        int fd = open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) return 0;
+
+        struct stat info;
+
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            return 0;
+        }
+
+#if defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(fd, 0, info.st_size, POSIX_FADV_WILLNEED);
+#endif
+#if defined(__linux__)
+        readahead(fd, 0, info.st_size);
+#endif
+
+        close(fd);
+
+        return (size_t) info.st_size;
+    }
+#endif
+
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (!file) return 0;
+
+    vector<char> buffer(PREFETCH_BUFFER);
+    size_t total = 0, count;
+
+    while ((count = fread(&buffer[0], 1, buffer.size(), file)) > 0)
+        total += count;
+
+    fclose(file);
+
+    return total;
+
+}
+
+// Checks if all pages of a file are in the page cache. Returns -1 if this
+// cannot be determined on the platform.
+int residentFile(const string& path) {
+
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) return 0;
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (info.st_size == 0) {
+        close(fd);
+        return 1;
+    }
+
+    void* address = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (address == MAP_FAILED) return -1;
+
+    long page = sysconf(_SC_PAGESIZE);
+    vector<unsigned char> pages((info.st_size + page - 1) / page);
+
+    int resident = -1;
+
+    if (mincore(address, info.st_size, &pages[0]) == 0) {
+        resident = 1;
+        for (size_t i = 0; i < pages.size(); i++) {
+            if (!(pages[i] & 1)) {
+                resident = 0;
+                break;
+            }
+        }
+    }
+
+    munmap(address, info.st_size);
+
+    return resident;
+#else
+    return -1;
+#endif
+
+}
+
+class FramePrefetcher {
+public:
+
+    FramePrefetcher(const vector<vector<string> >& frames, int depth, prefetch_mode mode) :
+        frames(frames), depth(depth), mode(mode), current(-1), stopped(false),
+        issued(frames.size(), 0), completed(frames.size(), 0),
+        hits(0), misses(0), prefetched(0), bytes(0) {
+
+        if (depth > 0)
+            worker = thread(&FramePrefetcher::run, this);
+
+    }
+
+    ~FramePrefetcher() {
+
+        {
+            lock_guard<mutex> lock(guard);
+            stopped = true;
+        }
+
+        changed.notify_all();
+
+        if (worker.joinable())
+            worker.join();
+
+    }
+
+    // Counts a hit or a miss for the frame and moves the window after it.
+    void advance(int frame) {
+
+        if (frame < 0 || frame >= (int) frames.size()) return;
+
+        int resident = 1;
+
+        for (size_t c = 0; c < frames[frame].size() && resident == 1; c++)
+            resident = residentFile(frames[frame][c]);
+
+        {
+            lock_guard<mutex> lock(guard);
+
+            // Without a page cache query a frame is a hit if it was prefetched
+            if (resident < 0)
+                resident = completed[frame];
+
+            if (resident)
+                hits++;
+            else
+                misses++;
+
+            current = frame;
+        }
+
+        changed.notify_all();
+
+    }
+
+    mxArray* statistics() {
+
+        const char* fields[] = {"hits", "misses", "prefetched", "bytes"};
+
+        mxArray* result = mxCreateStructMatrix(1, 1, 4, fields);
+
+        lock_guard<mutex> lock(guard);
+
+        mxSetField(result, 0, "hits", mxCreateDoubleScalar((double) hits));
+        mxSetField(result, 0, "misses", mxCreateDoubleScalar((double) misses));
+        mxSetField(result, 0, "prefetched", mxCreateDoubleScalar((double) prefetched));
+        mxSetField(result, 0, "bytes", mxCreateDoubleScalar((double) bytes));
+
+        return result;
+
+    }
+
+private:
+
+    void run() {
+
+        unique_lock<mutex> lock(guard);
+
+        while (!stopped) {
+
+            int next = -1;
+            int last = min(current + depth, (int) frames.size() - 1);
+
+            for (int f = current + 1; f <= last; f++) {
+                if (!issued[f]) {
+                    next = f;
+                    break;
+                }
+            }
+
+            if (next < 0) {
+                changed.wait(lock);
+                continue;
+            }
+
+            issued[next] = 1;
+
+            lock.unlock();
+
+            size_t size = 0;
+
+            for (size_t c = 0; c < frames[next].size(); c++)
+                size += prefetchFile(frames[next][c], mode);
+
+            lock.lock();
+
+            completed[next] = 1;
+            prefetched++;
+            bytes += size;
+
+        }
+
+    }
+
+    vector<vector<string> > frames;
+    int depth;
+    prefetch_mode mode;
+
+    int current;
+    bool stopped;
+    vector<char> issued;
+    vector<char> completed;
+
+    size_t hits;
+    size_t misses;
+    size_t prefetched;
+    size_t bytes;
+
+    mutex guard;
+    condition_variable changed;
+    thread worker;
+
+};
+
+// Prefetchers are released when the MEX function is cleared.
+static map<int, FramePrefetcher*> prefetchers;
+static int prefetcher_counter = 0;
+
+static void release_resources() {
+
+    for (map<int, FramePrefetcher*>::iterator it = prefetchers.begin(); it != prefetchers.end(); it++)
+        delete it->second;
+
+    prefetchers.clear();
+
+}
+
+int getPrefetcher(const mxArray* arg) {
+
+    int handle = getSingleInteger(arg);
+
+    if (prefetchers.find(handle) == prefetchers.end())
+        mexErrMsgTxt("Unknown prefetcher");
+
+    return handle;
+
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+    mexAtExit(release_resources);
+
+	if( nrhs < 1 ) mexErrMsgTxt("Command argument required.");
+
+    char* command = getString(prhs[0]);
+
+    int code = strcmpi(command, "open") == 0 ? 1 : (strcmpi(command, "advance") == 0 ? 2 : (strcmpi(command, "close") == 0 ? 3 : 0));
+
+    free(command);
+
+    if (code == 1) {
+
+        if( nrhs < 2 || nrhs > 4 ) mexErrMsgTxt("A cell array of files required (plus optional depth and mode).");
+        if( nlhs != 1 ) mexErrMsgTxt("Exactly one output argument required.");
+        if (!mxIsCell(prhs[1])) mexErrMsgTxt("Files must be a cell array");
+
+        int depth = nrhs > 2 ? getSingleInteger(prhs[2]) : 8;
+        prefetch_mode mode = PREFETCH_ADVISE;
+
+        if (nrhs > 3) {
+            char* name = getString(prhs[3]);
+            if (strcmpi(name, "read") == 0)
+                mode = PREFETCH_READ;
+            else if (strcmpi(name, "advise") != 0) {
+                free(name);
+                mexErrMsgTxt("Unknown prefetch mode");
+            }
+            free(name);
+        }
+
+        int channels = (int) mxGetM(prhs[1]);
+        int count = channels > 0 ? (int) (mxGetNumberOfElements(prhs[1]) / channels) : 0;
+
+        vector<vector<string> > frames(count, vector<string>(channels));
+
+        for (int i = 0; i < count * channels; i++) {
+            const mxArray* path = mxGetCell(prhs[1], i);
+            if (!path) mexErrMsgTxt("All files must be strings");
+            char* str = getString(path);
+            frames[i / channels][i % channels] = str;
+            free(str);
+        }
+
+        prefetchers[++prefetcher_counter] = new FramePrefetcher(frames, max(0, depth), mode);
+
+        plhs[0] = mxCreateDoubleScalar(prefetcher_counter);
+
+    } else if (code == 2) {
+
+        if( nrhs != 3 ) mexErrMsgTxt("Prefetcher and frame arguments required.");
+
+        if (mxIsEmpty(prhs[1])) return;
+
+        prefetchers[getPrefetcher(prhs[1])]->advance(getSingleInteger(prhs[2]) - 1);
+
+    } else if (code == 3) {
+
+        if( nrhs != 2 ) mexErrMsgTxt("Prefetcher argument required.");
+        if( nlhs > 1 ) mexErrMsgTxt("At most one output argument allowed.");
+
+        int handle = getPrefetcher(prhs[1]);
+
+        FramePrefetcher* prefetcher = prefetchers[handle];
+
+        if (nlhs > 0)
+            plhs[0] = prefetcher->statistics();
+
+        prefetchers.erase(handle);
+
+        delete prefetcher;
+
+    } else {
+        mexErrMsgTxt("Unknown command");
+    }
+
+}
@@ -0,0 +1,154 @@
+
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+#include "mex.h"
+#include "trajectory_reader.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+#if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER)
+#define strcmpi _strcmpi
+#else
+#define strcmpi strcasecmp
+#endif
+
+char* getString(const mxArray *arg) {
+
+	if (!mxIsChar(arg) || mxGetM(arg) > 1)
+		mexErrMsgTxt("Must be a string");
+
+    int l = (int) mxGetN(arg);
+
+    char* str = (char *) malloc(sizeof(char) * (l + 1));
+
+    mxGetString(arg, str, (l + 1));
+
+    return str;
+}
+
+int getSingleInteger(const mxArray *arg) {
+
+	if (mxGetM(arg) != 1 || mxGetN(arg) != 1)
+		mexErrMsgTxt("Parameter must be a single value");
+
+    if (mxIsInt32(arg))
+        return ((int*)mxGetPr(arg))[0];
+
+    if (mxIsDouble(arg))
+        return (int) ((double*)mxGetPr(arg))[0];
+
+    return 0;
+}
+
+static thread_pool pool;
+
+void release_resources() {
+
+    pool.resize(0);
+
+}
+
+// Reads a list of trajectory files on the shared thread pool. Files are
+// opened and parsed by worker threads, the output is created afterwards.
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+    mexAtExit(release_resources);
+
+	if( nrhs < 1 || nrhs > 4 ) mexErrMsgTxt("A cell array of paths, an optional number of threads, output format and cache flag or directory required.");
+	if (!mxIsCell(prhs[0])) mexErrMsgTxt("First argument must be a cell array of paths");
+
+	int threads = nrhs > 1 ? getSingleInteger(prhs[1]) : 1;
+	bool matrix = false;
+	// The cache argument is a flag (sidecars next to the files) or a directory
+	bool cache = false;
+	string directory;
+
+	if (nrhs > 3) {
+		if (mxIsChar(prhs[3])) {
+			char* str = getString(prhs[3]);
+			directory = str;
+			free(str);
+			cache = !directory.empty();
+		} else {
+			cache = !mxIsEmpty(prhs[3]) && mxGetScalar(prhs[3]) != 0;
+		}
+	}
+
+	if (nrhs > 2) {
+		char* format = getString(prhs[2]);
+		if (strcmpi(format, "matrix") == 0)
+			matrix = true;
+		else if (strcmpi(format, "cell") != 0) {
+			free(format);
+			mexErrMsgTxt("Unknown output format");
+		}
+		free(format);
+	}
+
+	if( nlhs > (matrix ? 3 : 2) ) mexErrMsgTxt("Too many output arguments.");
+
+	int count = (int) mxGetNumberOfElements(prhs[0]);
+
+	vector<string> paths(count);
+
+	for (int i = 0; i < count; i++) {
+		const mxArray* path = mxGetCell(prhs[0], i);
+		if (!path) mexErrMsgTxt("All paths must be strings");
+		char* str = getString(path);
+		paths[i] = str;
+		free(str);
+	}
+
+	vector<trajectory> results(count);
+	vector<char> loaded(count, 0);
+
+	pool.run(count, threads, 1, [&](int i) {
+		loaded[i] = trajectory_read(paths[i].c_str(), results[i], cache, directory) ? 1 : 0;
+	});
+
+	mwSize dimensions = mxGetNumberOfDimensions(prhs[0]);
+	const mwSize* size = mxGetDimensions(prhs[0]);
+
+	plhs[0] = mxCreateCellArray(dimensions, size);
+	mxArray* status = mxCreateNumericArray(dimensions, size, mxDOUBLE_CLASS, mxREAL);
+	mxArray* types = matrix ? mxCreateCellArray(dimensions, size) : NULL;
+
+	for (int i = 0; i < count; i++) {
+
+		if (!loaded[i]) continue;
+
+		mxGetPr(status)[i] = 1;
+
+		for (size_t j = 0; j < results[i].invalid.size(); j++) {
+			char message[500];
+			snprintf(message, sizeof(message), "Unable to parse region at line %d of %s, skipping.", results[i].invalid[j], paths[i].c_str());
+			mexWarnMsgTxt(message);
+		}
+
+		if (matrix) {
+			mxArray* regions = NULL;
+			mxArray* region_types = NULL;
+			trajectory_to_matrix(results[i], &regions, &region_types, NULL);
+			mxSetCell(plhs[0], i, regions);
+			mxSetCell(types, i, region_types);
+		} else {
+			mxSetCell(plhs[0], i, trajectory_to_cell(results[i]));
+		}
+
+		// Release the parsed values as soon as they are copied
+		results[i] = trajectory();
+
+	}
+
+	if (nlhs > 1) plhs[1] = status; else mxDestroyArray(status);
+
+	if (types) {
+		if (nlhs > 2) plhs[2] = types; else mxDestroyArray(types);
+	}
+
+}
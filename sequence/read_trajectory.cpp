@@ -1,15 +1,21 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include <vector>
 #include <string>
-#include <fstream>
 
 #include "mex.h"
-#include "region.h"
+#include "trajectory_reader.h"
 
 using namespace std;
 
+#if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER)
+#define strcmpi _strcmpi
+#else
+#define strcmpi strcasecmp
+#endif
+
 char* getString(const mxArray *arg) {
 
 	if (mxGetM(arg) != 1)
@@ -26,95 +32,58 @@ char* getString(const mxArray *arg) {
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 
-	if( nrhs != 1 ) mexErrMsgTxt("Exactly one string input argument required.");
-	if( nlhs != 1 ) mexErrMsgTxt("Exactly one output argument required.");
-
-	char* path = getString(prhs[0]);
-
-	std::ifstream ifs;
-	ifs.open (path, std::ifstream::in);
-
-	vector<region_container*> regions;
-
-	if (ifs.is_open()) {
-
-		int line_size = sizeof(char) * 2048;
-		char* line_buffer = (char*) malloc(line_size);
-		int line = 0;
-
-    	while (ifs.good()) {
-
-			line++;
-
-			if (!ifs.getline(line_buffer, line_size)) break;
-
-			region_container* region = NULL;
-
-			if (region_parse(line_buffer, &region)) {
-
-				regions.push_back(region);
-
-			} else {
-
-				char message[500];
-				sprintf(message, "Unable to parse region at line %d, skipping.", line);
-				mexWarnMsgTxt(message);
-
-			}
-
+	if( nrhs < 1 || nrhs > 3 ) mexErrMsgTxt("A path, an optional output format and an optional cache flag or directory required.");
+
+	bool matrix = false;
+	// The cache argument is a flag (sidecars next to the files) or a directory
+	bool cache = false;
+	string directory;
+
+	if (nrhs > 2) {
+		if (mxIsChar(prhs[2])) {
+			char* str = getString(prhs[2]);
+			directory = str;
+			free(str);
+			cache = !directory.empty();
+		} else {
+			cache = !mxIsEmpty(prhs[2]) && mxGetScalar(prhs[2]) != 0;
 		}
+	}
 
-        free(line_buffer);
-
-		plhs[0] = mxCreateCellMatrix((int)regions.size(), 1);
-
-		for (int i = 0; i < regions.size(); i++) {
-
-			mxArray* val = NULL;
-			region_container* region = regions[i];
-
-			switch (region->type) {
-			case RECTANGLE: {
-				val = mxCreateDoubleMatrix(1, 4, mxREAL);
-				double *p = (double*) mxGetPr(val);
-				p[0] = region->data.rectangle.x;
-				p[1] = region->data.rectangle.y;
-				p[2] = region->data.rectangle.width;
-				p[3] = region->data.rectangle.height;
-				break;
-			}
-			case POLYGON: {
-				val = mxCreateDoubleMatrix(1, region->data.polygon.count * 2, mxREAL);
-				double *p = (double*) mxGetPr(val);
-
-				for (int i = 0; i < region->data.polygon.count; i++) {
-					p[i*2] = region->data.polygon.x[i];
-					p[i*2+1] = region->data.polygon.y[i];
-				}
-
-				break;
-			}
-			case SPECIAL: {
-				val = mxCreateDoubleMatrix(1, 1, mxREAL);
-				double *p = (double*) mxGetPr(val);
-				p[0] = region->data.special;
-				break;
-			}
-			}
+	if (nrhs > 1) {
+		char* format = getString(prhs[1]);
+		if (strcmpi(format, "matrix") == 0)
+			matrix = true;
+		else if (strcmpi(format, "cell") != 0) {
+			free(format);
+			mexErrMsgTxt("Unknown output format");
+		}
+		free(format);
+	}
 
-			if (val) mxSetCell(plhs[0], i, val);
+	if( !matrix && nlhs > 1 ) mexErrMsgTxt("Exactly one output argument required.");
+	if( matrix && nlhs > 3 ) mexErrMsgTxt("At most three output arguments required.");
 
-			region_release(&region);
+	char* path = getString(prhs[0]);
 
-		}
+	trajectory result;
 
-	} else {
+	if (!trajectory_read(path, result, cache, directory)) {
 		free(path);
 		mexErrMsgTxt("Unable to open file for reading.");
 	}
 
-	ifs.close();
 	free(path);
-}
 
+	for (size_t i = 0; i < result.invalid.size(); i++) {
+		char message[500];
+		sprintf(message, "Unable to parse region at line %d, skipping.", result.invalid[i]);
+		mexWarnMsgTxt(message);
+	}
+
+	if (matrix)
+		trajectory_to_matrix(result, &plhs[0], nlhs > 1 ? &plhs[1] : NULL, nlhs > 2 ? &plhs[2] : NULL);
+	else
+		plhs[0] = trajectory_to_cell(result);
 
+}
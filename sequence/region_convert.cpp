@@ -1,9 +1,13 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
 
 #include "mex.h"
 #include "region.h"
+#include "region_rle.h"
 
 #if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER) 
 #define strcmpi _strcmpi
@@ -12,39 +16,39 @@
 #endif
 
 
-region_container* array_to_region(const mxArray * input) {
-    
+// Creates a region from a vector of values, a single value is a special code,
+// four values are a rectangle and an even number of at least six values is a polygon.
+region_container* values_to_region(const double* r, int l) {
+
     region_container* p = NULL;
-	double *r = (double*)mxGetPr(input);
-    int l = mxGetN(input);
-    
-    if (l % 2 == 0 && l > 6) {
-        
+
+    if (l % 2 == 0 && l >= 6) {
+
         p = region_create_polygon(l / 2);
-        
+
         for (int i = 0; i < p->data.polygon.count; i++) {
             p->data.polygon.x[i] = r[i*2];
             p->data.polygon.y[i] = r[i*2+1];
         }
-        
+
     } else if (l == 4) {
-        
+
         region_container* t = NULL;
 
         t = region_create_rectangle(r[0], r[1], r[2], r[3]);
-        
+
         p = region_convert(t, POLYGON);
-   
+
         region_release(&t);
-   
-    } if (l == 1) {
-        
+
+    } else if (l == 1) {
+
         p = region_create_special((int)r[0]);
-        
-    } 
-    
+
+    }
+
     return p;
-    
+
 }
 
 mxArray* region_to_array(const region_container* region) {
@@ -97,32 +101,424 @@ char* get_string(const mxArray *arg) {
     return cstr;
 }
 
-bool get_region_code(char* str, region_type& type) {
-    
+typedef enum { CONVERT_RECTANGLE, CONVERT_POLYGON, CONVERT_MASK, CONVERT_ROTATED } conversion_target;
+
+bool get_conversion_target(char* str, conversion_target& target) {
+
     if (strcmpi(str, "rectangle") == 0) {
-        type = RECTANGLE;
+        target = CONVERT_RECTANGLE;
 		return true;
     }
-    
+
     if (strcmpi(str, "polygon") == 0) {
-        type = POLYGON;
+        target = CONVERT_POLYGON;
+		return true;
+    }
+
+    if (strcmpi(str, "mask") == 0) {
+        target = CONVERT_MASK;
 		return true;
-    } 
+    }
+
+    if (strcmpi(str, "rotated") == 0) {
+        target = CONVERT_ROTATED;
+		return true;
+    }
 
   	return false;
 }
 
+// Returns the bounding rectangle of the foreground pixels of a mask or NULL if the mask is empty.
+region_container* mask_to_region(const rle_mask& mask) {
+
+    int left = 0, right = -1, top = 0, bottom = -1;
+
+    rle_mask_iterate(mask, [&](int row, int begin, int end) {
+        if (right < left) {
+            left = begin; right = end - 1; top = row; bottom = row;
+        } else {
+            left = MIN(left, begin); right = MAX(right, end - 1);
+            top = MIN(top, row); bottom = MAX(bottom, row);
+        }
+    });
+
+    if (right < left)
+        return NULL;
+
+    return region_create_rectangle(left, top, right - left + 1, bottom - top + 1);
+
+}
+
+// Rasterizes a polygon within its bounding box.
+void region_to_mask(region_container* region, rle_mask& mask) {
+
+    region_bounds bounds = region_compute_bounds(region);
+
+    int left = (int) floor(bounds.left);
+    int top = (int) floor(bounds.top);
+    int width = (int) ceil(bounds.right) - left + 1;
+    int height = (int) ceil(bounds.bottom) - top + 1;
+
+    std::vector<char> data((size_t) width * height);
+
+    region_get_mask_offset(region, &data[0], left, top, width, height);
+
+    rle_mask_encode(&data[0], left, top, width, height, mask);
+
+}
+
+typedef struct hull_point {
+    double x;
+    double y;
+} hull_point;
+
+static bool compare_points(const hull_point& a, const hull_point& b) {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+static double cross_product(const hull_point& o, const hull_point& a, const hull_point& b) {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// Computes the minimum area rectangle that contains the points by checking
+// the orientations of all edges of their convex hull. The rectangle is
+// stored as a polygon with four points.
+void minimum_area_rectangle(std::vector<hull_point> points, std::vector<double>& output) {
+
+    std::sort(points.begin(), points.end(), compare_points);
+
+    // Convex hull with the monotone chain algorithm
+    std::vector<hull_point> hull(2 * points.size());
+    int k = 0;
+
+    for (size_t i = 0; i < points.size(); i++) {
+        while (k >= 2 && cross_product(hull[k-2], hull[k-1], points[i]) <= 0) k--;
+        hull[k++] = points[i];
+    }
+
+    for (int i = (int) points.size() - 2, t = k + 1; i >= 0; i--) {
+        while (k >= t && cross_product(hull[k-2], hull[k-1], points[i]) <= 0) k--;
+        hull[k++] = points[i];
+    }
+
+    hull.resize(MAX(1, k - 1));
+
+    double best = -1, ux = 1, uy = 0;
+    double bounds[4] = {hull[0].x, hull[0].x, hull[0].y, hull[0].y};
+
+    for (size_t i = 0; i < hull.size() && hull.size() > 1; i++) {
+
+        const hull_point& a = hull[i];
+        const hull_point& b = hull[(i + 1) % hull.size()];
+
+        double length = sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+
+        if (length == 0) continue;
+
+        double dx = (b.x - a.x) / length, dy = (b.y - a.y) / length;
+        double extent[4] = {INFINITY, -INFINITY, INFINITY, -INFINITY};
+
+        for (size_t j = 0; j < hull.size(); j++) {
+            double u = hull[j].x * dx + hull[j].y * dy;
+            double v = hull[j].y * dx - hull[j].x * dy;
+            extent[0] = MIN(extent[0], u); extent[1] = MAX(extent[1], u);
+            extent[2] = MIN(extent[2], v); extent[3] = MAX(extent[3], v);
+        }
+
+        double area = (extent[1] - extent[0]) * (extent[3] - extent[2]);
+
+        // Earlier edges are kept on ties so that axis aligned boxes stay aligned
+        if (best < 0 || area < best - 1e-9 * best) {
+            best = area; ux = dx; uy = dy;
+            memcpy(bounds, extent, sizeof(bounds));
+        }
+
+    }
+
+    double corners[4][2] = {{bounds[0], bounds[2]}, {bounds[1], bounds[2]}, {bounds[1], bounds[3]}, {bounds[0], bounds[3]}};
+
+    output.clear();
+
+    for (int i = 0; i < 4; i++) {
+        // Inverse of the projection to (u, v) axes
+        output.push_back(corners[i][0] * ux - corners[i][1] * uy);
+        output.push_back(corners[i][0] * uy + corners[i][1] * ux);
+    }
+
+}
+
+void region_to_values(const region_container* region, std::vector<double>& output) {
+
+    output.clear();
+
+	switch (region->type) {
+	case RECTANGLE:
+		output.push_back(region->data.rectangle.x);
+		output.push_back(region->data.rectangle.y);
+		output.push_back(region->data.rectangle.width);
+		output.push_back(region->data.rectangle.height);
+		break;
+	case POLYGON:
+		for (int i = 0; i < region->data.polygon.count; i++) {
+			output.push_back(region->data.polygon.x[i]);
+			output.push_back(region->data.polygon.y[i]);
+		}
+		break;
+	case SPECIAL:
+		output.push_back(region->data.special);
+		break;
+	}
+
+}
+
+// Converts a region that is given either by values or by a mask (if values are
+// NULL) to the target format. Special codes are preserved. The result is stored
+// in output or, if result_mask is set to true, in result. Returns false if the
+// region is not valid or cannot be converted.
+bool convert_region(const double* values, int length, const rle_mask* input, conversion_target target,
+    std::vector<double>& output, rle_mask& result, bool& result_mask) {
+
+    region_container* p = NULL;
+
+    output.clear();
+    result_mask = false;
+
+    if (input) {
+
+        if (target == CONVERT_MASK) {
+            result = *input;
+            result_mask = true;
+            return true;
+        }
+
+        if (target == CONVERT_ROTATED) {
+
+            // Outer corners of every run, so that the rectangle covers the
+            // pixel extents like the bounding box of the mask
+            std::vector<hull_point> points;
+
+            rle_mask_iterate(*input, [&](int row, int begin, int end) {
+                hull_point corners[4] = {{(double) begin, (double) row}, {(double) end, (double) row},
+                    {(double) begin, (double) (row + 1)}, {(double) end, (double) (row + 1)}};
+                points.insert(points.end(), corners, corners + 4);
+            });
+
+            if (points.empty())
+                return false;
+
+            minimum_area_rectangle(points, output);
+            return true;
+
+        }
+
+        p = mask_to_region(*input);
+
+    } else if (length == 1) {
+
+        if (!isfinite(values[0]))
+            return false;
+
+        output.push_back((int) values[0]);
+        return true;
+
+    } else if (target == CONVERT_MASK && length == 4) {
+
+		// Rectangles are rasterized with corners in pixel centers as in region_overlap
+		p = region_create_polygon(4);
+		p->data.polygon.x[0] = values[0]; p->data.polygon.y[0] = values[1];
+		p->data.polygon.x[1] = values[0] + values[2] - 1; p->data.polygon.y[1] = values[1];
+		p->data.polygon.x[2] = values[0] + values[2] - 1; p->data.polygon.y[2] = values[1] + values[3] - 1;
+		p->data.polygon.x[3] = values[0]; p->data.polygon.y[3] = values[1] + values[3] - 1;
+
+    } else {
+
+        p = values_to_region(values, length);
+
+    }
+
+    // The bounding box of a mask is a rectangle, other regions are converted
+    // through a polygon
+    if (!p || (p->type != POLYGON && !input)) {
+        if (p) region_release(&p);
+        return false;
+    }
+
+    if (target == CONVERT_MASK) {
+
+        region_to_mask(p, result);
+        region_release(&p);
+        result_mask = true;
+        return true;
+
+    }
+
+    if (target == CONVERT_ROTATED) {
+
+        std::vector<hull_point> points(p->data.polygon.count);
+
+        for (int i = 0; i < p->data.polygon.count; i++) {
+            points[i].x = p->data.polygon.x[i];
+            points[i].y = p->data.polygon.y[i];
+        }
+
+        region_release(&p);
+        minimum_area_rectangle(points, output);
+        return true;
+
+    }
+
+    region_container* c = region_convert(p, target == CONVERT_RECTANGLE ? RECTANGLE : POLYGON);
+
+    region_release(&p);
+
+    if (!c)
+        return false;
+
+    region_to_values(c, output);
+    region_release(&c);
+
+    return true;
+
+}
+
+mxArray* values_to_array(const std::vector<double>& values) {
+
+    mxArray* val = mxCreateDoubleMatrix(1, values.size(), mxREAL);
+
+    if (!values.empty())
+        memcpy(mxGetPr(val), &values[0], sizeof(double) * values.size());
+
+    return val;
+
+}
+
+void invalid_region(int position) {
+
+    char message[128];
+    sprintf(message, "Unable to convert region at position %d", position);
+    mexErrMsgTxt(message);
+
+}
+
+// Converts a cell array of regions, the output has the same dimensions. If
+// skip is set, regions that cannot be converted are replaced by an empty
+// matrix instead of raising an error.
+mxArray* convert_cell(const mxArray* input, conversion_target target, bool skip) {
+
+    mxArray* output = mxCreateCellArray(mxGetNumberOfDimensions(input), mxGetDimensions(input));
+
+    std::vector<double> values;
+    rle_mask mask, result;
+    bool result_mask;
+
+    for (int i = 0; i < (int) mxGetNumberOfElements(input); i++) {
+
+        const mxArray* region = mxGetCell(input, i);
+
+        bool valid = region && mxGetNumberOfDimensions(region) <= 2 && MIN(mxGetM(region), mxGetN(region)) == 1;
+
+        if (!valid && !skip)
+            invalid_region(i + 1);
+
+        bool success = false;
+
+        if (!valid) {
+            success = false;
+        } else if (mxIsInt32(region)) {
+            success = rle_mask_from_array(region, mask) && convert_region(NULL, 0, &mask, target, values, result, result_mask);
+        } else if (mxIsDouble(region)) {
+            success = convert_region(mxGetPr(region), (int) mxGetNumberOfElements(region), NULL, target, values, result, result_mask);
+        }
+
+        if (!success) {
+            if (!skip)
+                invalid_region(i + 1);
+            continue;
+        }
+
+        mxSetCell(output, i, result_mask ? rle_mask_to_array(result) : values_to_array(values));
+
+    }
+
+    return output;
+
+}
+
+// Converts a matrix with one region per row padded with NaN values (the
+// format of read_trajectory). The output is a matrix in the same format or a
+// cell array of masks. If skip is set, rows that cannot be converted are
+// replaced by a row of NaN values (an empty cell for masks).
+mxArray* convert_matrix(const mxArray* input, conversion_target target, bool skip) {
+
+    int rows = (int) mxGetM(input);
+    int columns = (int) mxGetN(input);
+    const double* data = mxGetPr(input);
+
+    mxArray* output = target == CONVERT_MASK ? mxCreateCellMatrix(rows, 1) : NULL;
+
+    std::vector<std::vector<double> > converted(target == CONVERT_MASK ? 0 : rows);
+    std::vector<double> row(columns), values;
+    rle_mask result;
+    bool result_mask;
+    int width = 0;
+
+    for (int i = 0; i < rows; i++) {
+
+        int length = 0;
+
+        for (int j = 0; j < columns; j++) {
+            row[j] = data[j * rows + i];
+            if (!isnan(row[j])) length = j + 1;
+        }
+
+        if (!length || !convert_region(&row[0], length, NULL, target, values, result, result_mask)) {
+            if (!skip)
+                invalid_region(i + 1);
+            continue;
+        }
+
+        if (output) {
+            mxSetCell(output, i, result_mask ? rle_mask_to_array(result) : values_to_array(values));
+        } else {
+            width = MAX(width, (int) values.size());
+            converted[i].swap(values);
+        }
+
+    }
+
+    if (output)
+        return output;
+
+    output = mxCreateDoubleMatrix(rows, width, mxREAL);
+    double* out = mxGetPr(output);
+
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < width; j++)
+            out[j * rows + i] = j < (int) converted[i].size() ? converted[i][j] : NAN;
+
+    return output;
+
+}
+
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 
-	region_type format;
-	region_container* p = NULL;
+	conversion_target target;
 	region_container* c = NULL;
+    rle_mask mask, result;
+    std::vector<double> values;
+    bool result_mask;
 
 	if( nlhs != 1 ) mexErrMsgTxt("Exactly one output argument required.");
 
 	if( nrhs == 1 ) {
 		char* raw = get_string(prhs[0]);
 
+		if (rle_mask_parse(raw, mask)) {
+			free(raw);
+			plhs[0] = rle_mask_to_array(mask);
+			return;
+		}
+
 		region_parse(raw, &c);
 		free(raw);
 
@@ -130,40 +526,61 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 			mexErrMsgTxt("Not a valid region string");
 
 		plhs[0] = region_to_array(c);
+		region_release(&c);
 		return;
 	}
 
-	if( nrhs != 2 ) mexErrMsgTxt("Two vector arguments (region and format) required.");
-
-	if (mxGetClassID(prhs[0]) != mxDOUBLE_CLASS)
-		mexErrMsgTxt("First input argument must be of type double");
+	if( nrhs < 2 || nrhs > 3 ) mexErrMsgTxt("Two arguments (region and format) required (plus an optional skip flag for batches).");
 
-	if ( mxGetNumberOfDimensions(prhs[0]) > 2 || mxGetM(prhs[0]) > 1 ) mexErrMsgTxt("First input argument must be a vector");
+	bool skip = nrhs > 2 && mxGetNumberOfElements(prhs[2]) == 1 && mxGetScalar(prhs[2]) != 0;
 
 	char* codestr = get_string(prhs[1]);
 
-	if (!get_region_code(codestr, format)) {
+	if (!get_conversion_target(codestr, target)) {
 		free(codestr);
 		mexErrMsgTxt("Not a valid format");
 	}
 
 	free(codestr);
 
-	p = array_to_region(prhs[0]);
+	if (mxIsCell(prhs[0])) {
+		plhs[0] = convert_cell(prhs[0], target, skip);
+		return;
+	}
+
+	if (mxGetClassID(prhs[0]) != mxDOUBLE_CLASS && mxGetClassID(prhs[0]) != mxINT32_CLASS)
+		mexErrMsgTxt("First input argument must be of type double, int32 or a cell array");
+
+	if ( mxGetNumberOfDimensions(prhs[0]) > 2 ) mexErrMsgTxt("First input argument must be a vector or a matrix");
+
+	// With the skip flag a single row is converted as a batch of one region
+	if (mxIsDouble(prhs[0]) && (mxGetM(prhs[0]) > 1 || skip)) {
+		plhs[0] = convert_matrix(prhs[0], target, skip);
+		return;
+	}
+
+	if ( mxGetM(prhs[0]) > 1 ) mexErrMsgTxt("First input argument must be a vector");
+
+	if (mxIsInt32(prhs[0])) {
+
+		if (!rle_mask_from_array(prhs[0], mask))
+			mexErrMsgTxt("Not a valid mask region");
 
-	if (!p)
-		mexErrMsgTxt("Not a valid region vector");
+		if (!convert_region(NULL, 0, &mask, target, values, result, result_mask))
+			mexErrMsgTxt("Unable to convert region");
 
-	c = region_convert(p, format);
+	} else {
+
+		// Padding is stripped as for the rows of a matrix
+		const double* data = mxGetPr(prhs[0]);
+		int length = (int) mxGetN(prhs[0]);
+		while (length > 0 && isnan(data[length - 1])) length--;
+
+		if (!length || !convert_region(data, length, NULL, target, values, result, result_mask))
+			mexErrMsgTxt("Unable to convert region");
 
-	if (!c) {
-		if (p) region_release(&p);
-		mexErrMsgTxt("Unable to convert region");
 	}
 
-  plhs[0] = region_to_array(c);
+	plhs[0] = result_mask ? rle_mask_to_array(result) : values_to_array(values);
 
-	if (c) region_release(&c);
-	if (p) region_release(&p);
 }
-
@@ -2,7 +2,8 @@ function region_draw(region, color, width)
 % region_draw Draw a region on the current figure
 %
 % This functions is an utility that draws a region with a given color and stroke width.
-% A region can be a rectangle or a polygon.
+% A region can be a rectangle or a polygon, a mask region is drawn as the
+% bounding box of its pixels.
 %
 % Input:
 % - region (double vector): A vector of numbers describing a region.
@@ -18,6 +19,13 @@ if nargin < 3
     width = 1;
 end;
 
+if isa(region, 'int32')
+    if ~any(region(6:2:end))
+        return;
+    end;
+    region = region_convert(region, 'rectangle');
+end;
+
 if isnumeric(region)
 	if numel(region) == 4
 
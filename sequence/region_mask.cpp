@@ -1,48 +1,52 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <vector>
 
 #include "mex.h"
 #include "region.h"
+#include "region_rle.h"
+#include "thread_pool.h"
 
-#define MEX_TEST_DOUBLE(I) (mxGetClassID(prhs[I]) == mxDOUBLE_CLASS)
-#define MEX_TEST_VECTOR(I) (mxGetNumberOfDimensions(prhs[I]) == 2 && mxGetM(prhs[I]) == 1)
-
-#if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER) 
+#if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER)
 #define strcmpi _strcmpi
 #else
 #define strcmpi strcasecmp
 #endif
 
-region_container* get_polygon(const mxArray * input) {
-    
+// Output formats: a logical matrix (or a stack of them for a batch), a stack
+// of columns packed into bits and a list of masks cropped to the bounding box
+// of their pixels.
+typedef enum { FORMAT_FULL, FORMAT_PACKED, FORMAT_SPARSE } mask_format;
+
+region_container* get_polygon(const double* r, int l) {
+
     region_container* p = NULL;
-	double *r = (double*)mxGetPr(input);
-    int l = mxGetN(input);
-    
+
     if (l % 2 == 0 && l > 6) {
-        
+
         p = region_create_polygon(l / 2);
-        
+
         for (int i = 0; i < p->data.polygon.count; i++) {
             p->data.polygon.x[i] = r[i*2];
             p->data.polygon.y[i] = r[i*2+1];
         }
-        
+
     } else if (l == 4) {
-        
+
         region_container* t = NULL;
 
         t = region_create_rectangle(r[0], r[1], r[2], r[3]);
-        
+
         p = region_convert(t, POLYGON);
-   
+
         region_release(&t);
 
-    }  
-    
+    }
+
     return p;
-    
+
 }
 
 int getSingleInteger(const mxArray *arg) {
@@ -67,41 +71,330 @@ char* get_string(const mxArray *arg) {
     int l = (int) mxGetN(arg);
 
     char* cstr = (char *) malloc(sizeof(char) * (l + 1));
-    
+
     mxGetString(arg, cstr, (l + 1));
 
     return cstr;
 }
 
+// A region of a batch, either a polygon or a mask (or nothing for special
+// frames), extracted in the calling thread.
+typedef struct mask_source {
+    region_container* polygon;
+    bool is_mask;
+    rle_mask mask;
+} mask_source;
+
+// Pixels of a region within a box of the image in row-major order.
+typedef struct mask_crop {
+    int x;
+    int y;
+    int width;
+    int height;
+    std::vector<char> data;
+} mask_crop;
+
+void get_sources(const mxArray* input, std::vector<mask_source>& sources) {
+
+    if (mxIsCell(input)) {
+
+        sources.resize(mxGetNumberOfElements(input));
+
+        for (size_t i = 0; i < sources.size(); i++) {
+
+            const mxArray* region = mxGetCell(input, i);
+            mask_source& source = sources[i];
+
+            source.polygon = NULL;
+            source.is_mask = false;
+
+            if (!region || mxIsEmpty(region)) continue;
+
+            if (mxGetNumberOfDimensions(region) > 2 || mxGetM(region) > 1) mexErrMsgTxt("All regions must be vectors");
+
+            if (mxIsInt32(region)) {
+                if (!rle_mask_from_array(region, source.mask))
+                    mexErrMsgTxt("Not a valid mask region");
+                source.is_mask = true;
+            } else if (mxIsDouble(region)) {
+                source.polygon = get_polygon(mxGetPr(region), (int) mxGetN(region));
+            } else {
+                mexErrMsgTxt("Region input arguments must be of type double or int32");
+            }
+
+        }
+
+    } else if (mxIsInt32(input)) {
+
+        sources.resize(1);
+        sources[0].polygon = NULL;
+        sources[0].is_mask = true;
+
+        if (!rle_mask_from_array(input, sources[0].mask))
+            mexErrMsgTxt("Not a valid mask region");
+
+    } else {
+
+        if (!mxIsDouble(input) || mxGetNumberOfDimensions(input) > 2)
+            mexErrMsgTxt("First argument must be a vector, a matrix or a cell array of regions");
+
+        // Rows of a matrix are padded with NaN values
+        int count = (int) mxGetM(input);
+        int width = (int) mxGetN(input);
+        const double* data = mxGetPr(input);
+        std::vector<double> row(width);
+
+        sources.resize(count);
+
+        for (int i = 0; i < count; i++) {
+            int l = 0;
+            for (int j = 0; j < width; j++) {
+                row[j] = data[i + j * count];
+                if (!mxIsNaN(row[j])) l = j + 1;
+            }
+            sources[i].polygon = get_polygon(&row[0], l);
+            sources[i].is_mask = false;
+        }
+
+    }
+
+}
+
+// Rasterizes a region within its bounding box clipped to the image.
+void rasterize_source(const mask_source& source, int width, int height, mask_crop& crop) {
+
+    crop.x = crop.y = crop.width = crop.height = 0;
+    crop.data.clear();
+
+    int left, top, right, bottom;
+
+    if (source.is_mask) {
+
+        const rle_mask& mask = source.mask;
+
+        left = MAX(mask.x, 0); right = MIN(mask.x + mask.width, width) - 1;
+        top = MAX(mask.y, 0); bottom = MIN(mask.y + mask.height, height) - 1;
+
+    } else if (source.polygon) {
+
+        region_bounds bounds = region_compute_bounds(source.polygon);
+
+        left = (int) MAX(floor(bounds.left), 0); right = (int) MIN(ceil(bounds.right), width - 1);
+        top = (int) MAX(floor(bounds.top), 0); bottom = (int) MIN(ceil(bounds.bottom), height - 1);
+
+    } else return;
+
+    if (right < left || bottom < top) return;
+
+    crop.x = left;
+    crop.y = top;
+    crop.width = right - left + 1;
+    crop.height = bottom - top + 1;
+    crop.data.assign((size_t) crop.width * crop.height, 0);
+
+    if (source.is_mask) {
+        rle_mask_iterate(source.mask, [&](int row, int begin, int end) {
+            if (row < top || row > bottom) return;
+            begin = MAX(begin, left); end = MIN(end, right + 1);
+            if (begin < end) memset(&crop.data[(size_t) (row - top) * crop.width + begin - left], 1, end - begin);
+        });
+    } else {
+        // Scanline crossings are computed relative to the left edge of the
+        // mask and may round differently if it is moved, so the rows are
+        // rasterized from the left edge of the image to match a full mask.
+        std::vector<char> rows((size_t) (right + 1) * crop.height);
+        region_get_mask_offset(source.polygon, &rows[0], 0, top, right + 1, crop.height);
+        for (int j = 0; j < crop.height; j++)
+            memcpy(&crop.data[(size_t) j * crop.width], &rows[(size_t) j * (right + 1) + left], crop.width);
+    }
+
+}
+
+// Shrinks the crop to the bounding box of its pixels.
+void tighten_crop(mask_crop& crop) {
+
+    int left = crop.width, right = -1, top = crop.height, bottom = -1;
+
+    for (int j = 0; j < crop.height; j++) {
+        const char* row = &crop.data[(size_t) j * crop.width];
+        for (int i = 0; i < crop.width; i++) {
+            if (!row[i]) continue;
+            left = MIN(left, i); right = MAX(right, i);
+            top = MIN(top, j); bottom = j;
+        }
+    }
+
+    if (right < 0) {
+        crop.x = crop.y = crop.width = crop.height = 0;
+        crop.data.clear();
+        return;
+    }
+
+    int width = right - left + 1;
+    int height = bottom - top + 1;
+
+    for (int j = 0; j < height; j++)
+        memmove(&crop.data[(size_t) j * width], &crop.data[(size_t) (j + top) * crop.width + left], width);
+
+    crop.data.resize((size_t) width * height);
+    crop.x += left;
+    crop.y += top;
+    crop.width = width;
+    crop.height = height;
+
+}
+
+// Copies the crop to a column-major logical matrix with the given number of rows.
+void write_full(const mask_crop& crop, char* output, int rows) {
+
+    for (int j = 0; j < crop.height; j++) {
+        const char* row = &crop.data[(size_t) j * crop.width];
+        for (int i = 0; i < crop.width; i++)
+            if (row[i]) output[(size_t) (crop.x + i) * rows + crop.y + j] = 1;
+    }
+
+}
+
+// Sets the bits of a column-major matrix where every column is packed into
+// bytes, the pixel in row r is the bit r % 8 (least significant first) of the
+// byte r / 8 of its column.
+void write_packed(const mask_crop& crop, unsigned char* output, int rows) {
+
+    int bytes = (rows + 7) / 8;
+
+    for (int j = 0; j < crop.height; j++) {
+        const char* row = &crop.data[(size_t) j * crop.width];
+        int y = crop.y + j;
+        for (int i = 0; i < crop.width; i++)
+            if (row[i]) output[(size_t) (crop.x + i) * bytes + y / 8] |= (unsigned char) (1 << (y % 8));
+    }
+
+}
+
+static thread_pool pool;
+
+void release_resources() {
+
+    pool.resize(0);
+
+}
+
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 
-	region_container* p = NULL;
+    mexAtExit(release_resources);
 
-	if( nrhs < 3 ) mexErrMsgTxt("One vector and two integer arguments required.");
-	if( nlhs != 1 ) mexErrMsgTxt("Exactly one output argument required.");
+    if( nrhs < 3 ) mexErrMsgTxt("One region and two integer arguments required.");
 
-	if (!MEX_TEST_VECTOR(0) || !MEX_TEST_DOUBLE(0)) mexErrMsgTxt("First argument must be a vector of type double");
+    mask_format format = FORMAT_FULL;
+    int threads = 0;
 
     region_clear_flags(REGION_LEGACY_RASTERIZATION);
     if (nrhs > 3) {
-	    char* codestr = get_string(prhs[3]);
-	    if (strcmpi(codestr, "legacy") == 0) 
-		    region_set_flags(REGION_LEGACY_RASTERIZATION);
-	    free(codestr);
+        char* codestr = get_string(prhs[3]);
+        if (strcmpi(codestr, "legacy") == 0)
+            region_set_flags(REGION_LEGACY_RASTERIZATION);
+        free(codestr);
     }
 
-	int width = getSingleInteger(prhs[1]);
-	int height = getSingleInteger(prhs[2]);
+    if (nrhs > 4) {
+        char* codestr = get_string(prhs[4]);
+        if (strcmpi(codestr, "full") == 0)
+            format = FORMAT_FULL;
+        else if (strcmpi(codestr, "packed") == 0)
+            format = FORMAT_PACKED;
+        else if (strcmpi(codestr, "sparse") == 0)
+            format = FORMAT_SPARSE;
+        else {
+            free(codestr);
+            mexErrMsgTxt("Unknown output format");
+        }
+        free(codestr);
+    }
+
+    if (nrhs > 5)
+        threads = getSingleInteger(prhs[5]);
+
+    if( nlhs != 1 && !(format == FORMAT_SPARSE && nlhs == 2) ) mexErrMsgTxt("Exactly one output argument required.");
+
+    int width = getSingleInteger(prhs[1]);
+    int height = getSingleInteger(prhs[2]);
+
+    if (width < 0 || height < 0) mexErrMsgTxt("Image size must not be negative");
+
+    std::vector<mask_source> sources;
+
+    get_sources(prhs[0], sources);
+
+    int count = (int) sources.size();
+
+    // A single region produces a matrix, a batch a stack of matrices
+    mwSize dimensions[3] = {(mwSize) height, (mwSize) width, (mwSize) count};
+    char* full = NULL;
+    unsigned char* packed = NULL;
+    std::vector<mask_crop> crops(format == FORMAT_SPARSE ? count : 0);
+
+    if (format == FORMAT_FULL) {
+        plhs[0] = mxCreateLogicalArray(3, dimensions);
+        full = (char*) mxGetData(plhs[0]);
+    } else if (format == FORMAT_PACKED) {
+        dimensions[0] = (height + 7) / 8;
+        plhs[0] = mxCreateNumericArray(3, dimensions, mxUINT8_CLASS, mxREAL);
+        packed = (unsigned char*) mxGetData(plhs[0]);
+    }
+
+    size_t frame = (size_t) width * dimensions[0];
+
+    pool.run(count, threads, 1, [&](int i) {
 
-	p = get_polygon(prhs[0]);
-	float* tmp = p->data.polygon.x; p->data.polygon.x = p->data.polygon.y; p->data.polygon.y = tmp;
+        if (format == FORMAT_SPARSE) {
+            rasterize_source(sources[i], width, height, crops[i]);
+            tighten_crop(crops[i]);
+            return;
+        }
+
+        mask_crop crop;
+        rasterize_source(sources[i], width, height, crop);
+
+        if (full)
+            write_full(crop, full + frame * i, height);
+        else
+            write_packed(crop, packed + frame * i, height);
+
+    });
+
+    for (int i = 0; i < count; i++)
+        if (sources[i].polygon) region_release(&sources[i].polygon);
+
+    if (format != FORMAT_SPARSE)
+        return;
+
+    plhs[0] = mxCreateCellMatrix(count, 1);
+    mxArray* boxes = mxCreateDoubleMatrix(count, 4, mxREAL);
+    double* b = mxGetPr(boxes);
+
+    for (int i = 0; i < count; i++) {
+
+        const mask_crop& crop = crops[i];
+        mxArray* mask = mxCreateLogicalMatrix(crop.height, crop.width);
+        char* data = (char*) mxGetData(mask);
+
+        for (int j = 0; j < crop.height; j++)
+            for (int k = 0; k < crop.width; k++)
+                data[(size_t) k * crop.height + j] = crop.data[(size_t) j * crop.width + k];
+
+        mxSetCell(plhs[0], i, mask);
+
+        b[i] = crop.x;
+        b[i + count] = crop.y;
+        b[i + count * 2] = crop.width;
+        b[i + count * 3] = crop.height;
+
+    }
 
-    plhs[0] = mxCreateLogicalMatrix(height, width);
-    char *result = (char*) mxGetData(plhs[0]);
-            
-    region_get_mask(p, result, width, height);
-    
-    if (p) region_release(&p);
+    if (nlhs > 1)
+        plhs[1] = boxes;
+    else
+        mxDestroyArray(boxes);
 
 }
 
@@ -1,9 +1,24 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <memory>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 
 #include "mex.h"
 #include "region.h"
+#include "thread_pool.h"
+#include "region_rle.h"
 
 #if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER)
 #define strcmpi _strcmpi
@@ -13,6 +28,8 @@
 
 #define PRINT_REGION(R) { char* S = region_string(R); mexPrintf("%s\n", S); free(S); }
 
+typedef enum overlap_mode { MODE_DEFAULT, MODE_LEGACY, MODE_EXACT } overlap_mode;
+
 region_bounds get_bounds(const mxArray * input) {
 
     region_bounds bounds;
@@ -50,161 +67,1647 @@ region_bounds get_bounds(const mxArray * input) {
 
 }
 
-region_container* get_polygon(const mxArray * input) {
+// Regions of a batch are extracted into a flat buffer of polygon vertices in
+// the calling thread, so that the pairs can be scored by worker threads that
+// must not touch the MEX API. A rectangle is stored as a polygon with corners
+// at x and x + w - 1 for the rasterization modes (pixel centers) and at x and
+// x + w for the exact mode. Masks are stored as spans clipped to the bounds.
+// Regions that can not be scored (e.g. special codes) are stored with zero
+// vertices.
+
+// Pixel coverage of a region as a list of column spans for every row of its
+// box: rows[j] and rows[j + 1] delimit the spans of the row top + j, a span is
+// a pair of absolute columns with an exclusive end.
+
+#define SPANS_MAX_SIZE 10000
+
+typedef struct region_spans {
+    bool valid;
+    region_bounds box;
+    int top;
+    int area;
+    std::vector<int> rows;
+    std::vector<int> spans;
+} region_spans;
+
+typedef struct region_buffer {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<int> offset;
+    std::vector<int> count;
+    std::vector<int> mask;
+    std::vector<region_spans> masks;
+} region_buffer;
+
+bool region_buffer_valid(const region_buffer& buffer, int index) {
+
+    return buffer.count[index] > 0 || buffer.mask[index] >= 0;
 
-    if (!mxIsDouble(input)) {
-        mexErrMsgTxt("Polygon has to be an array of doubles");
-    }
+}
 
-    region_container* p = NULL;
-	double *r = (double*)mxGetPr(input);
-    int l = MAX(mxGetN(input), mxGetM(input));
+int region_buffer_push(region_buffer& buffer, const double* r, int l, overlap_mode mode) {
 
-    if (l % 2 == 0 && l > 6) {
+    int index = (int) buffer.offset.size();
 
-        p = region_create_polygon(l / 2);
+    buffer.offset.push_back((int) buffer.x.size());
+    buffer.mask.push_back(-1);
 
-        for (int i = 0; i < p->data.polygon.count; i++) {
-            p->data.polygon.x[i] = r[i*2];
-            p->data.polygon.y[i] = r[i*2+1];
+    // The exact mode does not snap coordinates to pixels, regions with
+    // non-finite coordinates are invalid and their pairs are not scored
+    bool finite = true;
+    for (int i = 0; mode == MODE_EXACT && i < l; i++)
+        if (!mxIsFinite(r[i])) finite = false;
+
+    if (!finite) {
+
+        buffer.count.push_back(0);
+
+    } else if (l % 2 == 0 && l > 6) {
+
+        for (int i = 0; i < l / 2; i++) {
+            buffer.x.push_back(r[i*2]);
+            buffer.y.push_back(r[i*2+1]);
         }
 
+        buffer.count.push_back(l / 2);
+
     } else if (l == 4) {
 
-        p = region_create_polygon(4);
+        double extent = (mode == MODE_EXACT) ? 0 : 1;
+
+        buffer.x.push_back(r[0]);
+        buffer.x.push_back(r[0] + r[2] - extent);
+        buffer.x.push_back(r[0] + r[2] - extent);
+        buffer.x.push_back(r[0]);
+
+        buffer.y.push_back(r[1]);
+        buffer.y.push_back(r[1]);
+        buffer.y.push_back(r[1] + r[3] - extent);
+        buffer.y.push_back(r[1] + r[3] - extent);
+
+        buffer.count.push_back(4);
 
-        p->data.polygon.x[0] = r[0];
-        p->data.polygon.x[1] = r[0] + r[2] - 1;
-        p->data.polygon.x[2] = r[0] + r[2] - 1;
-        p->data.polygon.x[3] = r[0];
+    } else {
 
-        p->data.polygon.y[0] = r[1];
-        p->data.polygon.y[1] = r[1];
-        p->data.polygon.y[2] = r[1] + r[3] - 1;
-        p->data.polygon.y[3] = r[1] + r[3] - 1;
+        buffer.count.push_back(0);
 
     }
 
-    return p;
+    return index;
 
 }
 
-region_overlap compute_overlap(const mxArray* r1, const mxArray* r2, region_bounds bounds) {
+int region_buffer_push_mask(region_buffer& buffer, const rle_mask& mask, region_bounds bounds) {
 
-	region_container* p1;
-	region_container* p2;
+    int index = (int) buffer.offset.size();
 
-    if ( mxGetNumberOfDimensions(r1) > 2 || mxGetM(r1) > 1 ) mexErrMsgTxt("All regions must be vectors");
-    if ( mxGetNumberOfDimensions(r2) > 2 || mxGetM(r2) > 1 ) mexErrMsgTxt("All regions must be vectors");
+    buffer.offset.push_back((int) buffer.x.size());
+    buffer.count.push_back(0);
+    buffer.mask.push_back((int) buffer.masks.size());
+    buffer.masks.push_back(region_spans());
 
-    // TODO: accept integer for special frames
-    if (mxGetClassID(r1) != mxDOUBLE_CLASS)
-	    mexErrMsgTxt("Region input arguments must be of type double");
+    region_spans& spans = buffer.masks.back();
 
-    if (mxGetClassID(r2) != mxDOUBLE_CLASS)
-	    mexErrMsgTxt("Region input arguments must be of type double");
+    int top = (int) MAX((double) mask.y, ceil(bounds.top));
+    int bottom = (int) MIN((double) mask.y + mask.height, floor(bounds.bottom) + 1);
+    int left = (int) MAX((double) mask.x, ceil(bounds.left));
+    int right = (int) MIN((double) mask.x + mask.width, floor(bounds.right) + 1);
 
-    p1 = get_polygon(r1);
-    p2 = get_polygon(r2);
+    spans.valid = true;
+    spans.box.left = (float) left;
+    spans.box.top = (float) top;
+    spans.box.right = (float) (right - 1);
+    spans.box.bottom = (float) (bottom - 1);
+    spans.top = top;
+    spans.area = 0;
+    spans.rows.assign(MAX(bottom - top, 0) + 1, 0);
 
-    region_overlap overlap;
+    int last = top;
+
+    rle_mask_iterate(mask, [&](int row, int begin, int end) {
+        begin = MAX(begin, left);
+        end = MIN(end, right);
+        if (row < top || row >= bottom || end <= begin) return;
+        for (; last < row; last++) spans.rows[last - top + 1] = (int) spans.spans.size();
+        spans.spans.push_back(begin);
+        spans.spans.push_back(end);
+        spans.area += end - begin;
+    });
+
+    for (; last < bottom; last++) spans.rows[last - top + 1] = (int) spans.spans.size();
+
+    return index;
+
+}
+
+// A batch of regions is given either as a cell array of vectors or as a dense
+// matrix with one region per row, padded with NaN values when the regions have
+// a different number of values. Rows of a matrix are read directly without
+// creating intermediate arrays. An optional vector with a type code for every
+// region (0 for special frames, 1 for rectangles and 2 for polygons) can be
+// given to override the detection of the type from the number of values.
+// Masks are given as int32 vectors in a cell array or with the type code 3.
 
-    if (p1 != NULL && p2 != NULL) {
+typedef struct region_source {
+    const mxArray* input;
+    const double* data;
+    const double* types;
+    bool cell;
+    bool single;
+    int count;
+    int width;
+    std::vector<double> row;
+    rle_mask mask;
+} region_source;
 
-        overlap = region_compute_overlap(p1, p2, bounds);
+void get_source(region_source& source, const mxArray* input, const mxArray* types, bool batch) {
+
+    source.input = input;
+    source.data = NULL;
+    source.types = NULL;
+    source.cell = mxIsCell(input);
+    source.single = !batch;
+    source.width = 0;
+
+    if (!batch) {
+
+        source.count = 1;
+
+    } else if (source.cell) {
+
+        if ( MIN(mxGetM(input), mxGetN(input)) != 1 ) mexErrMsgTxt("Cell array must be a vector");
+
+        source.count = MAX(mxGetM(input), mxGetN(input));
 
     } else {
 
-        overlap.overlap = -1;
+        if (mxGetClassID(input) != mxDOUBLE_CLASS || mxGetNumberOfDimensions(input) > 2)
+            mexErrMsgTxt("Regions must be given as a cell array or as a matrix of doubles");
+
+        source.data = (double*)mxGetPr(input);
+        source.count = (int) mxGetM(input);
+        source.width = (int) mxGetN(input);
+        source.row.resize(source.width);
+
+    }
+
+    if (types && !mxIsEmpty(types)) {
+
+        if (mxGetClassID(types) != mxDOUBLE_CLASS || (int) mxGetNumberOfElements(types) != source.count)
+            mexErrMsgTxt("Region types must be a vector of doubles with one value per region");
+
+        source.types = (double*)mxGetPr(types);
+
+    }
+
+}
+
+// Returns the values of the i-th region of the source and sets their number,
+// NULL is returned for a missing region. For a mask the number is set to -1
+// and the mask is stored in the source.
+const double* get_source_region(region_source& source, int i, int* length) {
+
+    const double* r = NULL;
+    int l = 0;
+    bool mask = false;
+
+    if (source.data) {
+
+        for (int j = 0; j < source.width; j++)
+            source.row[j] = source.data[i + j * source.count];
+
+        // A row of NaN values is not padding but a region with undefined values
+        l = source.width;
+        while (l > 0 && mxIsNaN(source.row[l - 1])) l--;
+        if (l == 0) l = source.width;
+
+        r = l > 0 ? &source.row[0] : NULL;
+
+    } else {
+
+        const mxArray* input = source.single ? source.input : mxGetCell(source.input, i);
+
+        if (input) {
+
+            if ( mxGetNumberOfDimensions(input) > 2 || mxGetM(input) > 1 ) mexErrMsgTxt("All regions must be vectors");
+
+            if (mxIsInt32(input)) {
+
+                if (!rle_mask_from_array(input, source.mask))
+                    mexErrMsgTxt("Not a valid mask region");
+
+                mask = true;
+
+            } else {
+
+                // TODO: accept integer for special frames
+                if (mxGetClassID(input) != mxDOUBLE_CLASS)
+                    mexErrMsgTxt("Region input arguments must be of type double");
+
+                r = (double*)mxGetPr(input);
+                l = (int) mxGetN(input);
+
+                // Padding is stripped as for the rows of a matrix
+                int n = l;
+                while (n > 0 && mxIsNaN(r[n - 1])) n--;
+                if (n > 0) l = n;
+
+            }
+
+        }
+
+    }
+
+    if (source.types) {
+        int type = (int) source.types[i];
+        if (mask) {
+            mask = type == 3;
+        } else {
+            switch (type) {
+            case 1: l = (l >= 4) ? 4 : 0; break;
+            case 2: l = (l > 6) ? l - l % 2 : 0; break;
+            case 3: mask = r && rle_mask_from_values(r, l, source.mask); l = 0; break;
+            default: l = 0;
+            }
+        }
+    }
+
+    if (mask) {
+        *length = -1;
+        return NULL;
+    }
+
+    *length = r ? l : 0;
+
+    return r;
+
+}
+
+typedef struct region_pair {
+    int index;
+    int first;
+    int second;
+} region_pair;
+
+// The exact mode computes the overlap geometrically instead of counting pixels.
+// A rectangle [x y w h] covers [x, x + w] x [y, y + h], a polygon is taken as
+// it is and bounds given in pixel indices cover [left, right + 1] x [top,
+// bottom + 1]. Convex polygons are intersected with a single Sutherland-Hodgman
+// clip, other polygons are decomposed into a fan of signed triangles so that
+// the intersection area is a signed sum of convex intersections.
+
+typedef struct point {
+    double x;
+    double y;
+} point;
+
+typedef std::vector<point> contour;
+
+void get_contour(const region_buffer& buffer, int index, contour& c) {
+
+    c.clear();
+
+    for (int i = 0; i < buffer.count[index]; i++) {
+        point p = { buffer.x[buffer.offset[index] + i], buffer.y[buffer.offset[index] + i] };
+        c.push_back(p);
+    }
+
+}
+
+double contour_area(const contour& c) {
+
+    double area = 0;
+
+    for (size_t i = 0, j = c.size() - 1; i < c.size(); j = i++)
+        area += c[j].x * c[i].y - c[i].x * c[j].y;
+
+    return area / 2;
+
+}
+
+// Turns of equal sign are not enough, a self-intersecting contour such as a
+// pentagram turns the same way at every vertex but winds around more than
+// once. The horizontal direction of the edges of a simple convex contour
+// changes its sign at most twice, so contours with more changes are rejected.
+bool contour_convex(const contour& c) {
+
+    int sign = 0, first = 0, direction = 0, changes = 0;
+    size_t n = c.size();
+
+    for (size_t i = 0; i < n; i++) {
+        const point& a = c[i];
+        const point& b = c[(i + 1) % n];
+        const point& d = c[(i + 2) % n];
+
+        int h = (b.x > a.x) - (b.x < a.x);
+        if (h != 0) {
+            if (first == 0) first = h;
+            else if (h != direction) changes++;
+            direction = h;
+        }
+
+        double cross = (b.x - a.x) * (d.y - b.y) - (b.y - a.y) * (d.x - b.x);
+        int s = (cross > 0) - (cross < 0);
+        if (s == 0) continue;
+        if (sign == 0) sign = s;
+        else if (s != sign) return false;
+    }
+
+    if (direction != first) changes++;
+
+    return changes <= 2;
+
+}
+
+// Keeps the part of the subject on the left side of the directed line a -> b.
+void clip_halfplane(const contour& subject, point a, point b, contour& output) {
+
+    output.clear();
+
+    if (subject.empty()) return;
+
+    double dx = b.x - a.x, dy = b.y - a.y;
+
+    const point* s = &subject[subject.size() - 1];
+    double ds = dx * (s->y - a.y) - dy * (s->x - a.x);
+
+    for (size_t i = 0; i < subject.size(); i++) {
+        const point* e = &subject[i];
+        double de = dx * (e->y - a.y) - dy * (e->x - a.x);
+
+        if ((de >= 0) != (ds >= 0)) {
+            double t = ds / (ds - de);
+            point p = { s->x + t * (e->x - s->x), s->y + t * (e->y - s->y) };
+            output.push_back(p);
+        }
+
+        if (de >= 0) output.push_back(*e);
+
+        s = e;
+        ds = de;
+    }
+
+}
+
+// Clips the subject with a convex clip contour of positive orientation.
+double clip_convex_area(const contour& subject, const contour& clip, contour& buffer1, contour& buffer2) {
+
+    buffer1 = subject;
+
+    for (size_t i = 0, j = clip.size() - 1; i < clip.size() && !buffer1.empty(); j = i++) {
+        clip_halfplane(buffer1, clip[j], clip[i], buffer2);
+        buffer1.swap(buffer2);
+    }
+
+    return buffer1.size() < 3 ? 0 : contour_area(buffer1);
+
+}
+
+void clip_bounds(contour& c, region_bounds bounds) {
+
+    point corners[4] = { { bounds.left, bounds.top }, { bounds.right + 1.0, bounds.top },
+        { bounds.right + 1.0, bounds.bottom + 1.0 }, { bounds.left, bounds.bottom + 1.0 } };
+
+    contour buffer;
+
+    for (int i = 0, j = 3; i < 4; j = i++) {
+        clip_halfplane(c, corners[j], corners[i], buffer);
+        c.swap(buffer);
+    }
+
+}
+
+// Splits a contour of positive orientation into convex pieces with signs, so
+// that the sum of signed indicator functions of pieces equals the winding
+// number of the contour almost everywhere.
+void convex_pieces(const contour& c, std::vector<contour>& pieces, std::vector<int>& signs) {
+
+    pieces.clear();
+    signs.clear();
+
+    if (contour_convex(c)) {
+        pieces.push_back(c);
+        signs.push_back(1);
+        return;
+    }
+
+    for (size_t i = 1; i + 1 < c.size(); i++) {
+        contour triangle;
+        triangle.push_back(c[0]);
+        triangle.push_back(c[i]);
+        triangle.push_back(c[i + 1]);
+        double area = contour_area(triangle);
+        if (area == 0) continue;
+        if (area < 0) std::swap(triangle[1], triangle[2]);
+        pieces.push_back(triangle);
+        signs.push_back(area > 0 ? 1 : -1);
+    }
+
+}
+
+// A region prepared for the exact mode, clipped to bounds and split into
+// convex pieces, so that it can be intersected with many other regions.
+typedef struct exact_region {
+    double area;
+    std::vector<contour> pieces;
+    std::vector<int> signs;
+} exact_region;
+
+void prepare_exact_region(const region_buffer& buffer, int index, region_bounds bounds, exact_region& region) {
+
+    contour c;
+
+    get_contour(buffer, index, c);
+
+    if (contour_area(c) < 0) std::reverse(c.begin(), c.end());
+
+    clip_bounds(c, bounds);
+
+    region.area = c.size() < 3 ? 0 : contour_area(c);
+
+    if (region.area > 0)
+        convex_pieces(c, region.pieces, region.signs);
+
+}
+
+region_overlap combine_exact_regions(const exact_region& r1, const exact_region& r2) {
+
+    region_overlap overlap;
+    double intersection = 0;
+
+    if (r1.area > 0 && r2.area > 0) {
+
+        contour buffer1, buffer2;
+
+        for (size_t i = 0; i < r1.pieces.size(); i++)
+            for (size_t j = 0; j < r2.pieces.size(); j++)
+                intersection += r1.signs[i] * r2.signs[j] * clip_convex_area(r1.pieces[i], r2.pieces[j], buffer1, buffer2);
+
+        intersection = MAX(0, MIN(intersection, MIN(r1.area, r2.area)));
 
     }
 
-    if (p1) region_release(&p1);
-    if (p2) region_release(&p2);
+    double total = r1.area + r2.area - intersection;
+
+    if (total > 0) {
+        overlap.overlap = (float) (intersection / total);
+        overlap.only1 = (float) ((r1.area - intersection) / total);
+        overlap.only2 = (float) ((r2.area - intersection) / total);
+    } else {
+        overlap.overlap = 0;
+        overlap.only1 = 0;
+        overlap.only2 = 0;
+    }
 
     return overlap;
+
 }
 
-char* get_string(const mxArray *arg) {
+region_overlap compute_exact_overlap(const region_buffer& buffer, int first, int second, region_bounds bounds) {
 
-	if (mxGetM(arg) != 1)
-		mexErrMsgTxt("Must be an array of chars");
+    exact_region r1, r2;
 
-    int l = (int) mxGetN(arg);
+    prepare_exact_region(buffer, first, bounds, r1);
+    prepare_exact_region(buffer, second, bounds, r2);
 
-    char* cstr = (char *) malloc(sizeof(char) * (l + 1));
+    return combine_exact_regions(r1, r2);
 
-    mxGetString(arg, cstr, (l + 1));
+}
+
+region_overlap compute_raster_overlap(const region_buffer& buffer1, int first, const region_buffer& buffer2, int second, region_bounds bounds) {
+
+    int n1 = buffer1.count[first], n2 = buffer2.count[second];
+    std::vector<float> coordinates((n1 + n2) * 2);
+
+    region_container p1, p2;
+
+    p1.type = POLYGON;
+    p1.data.polygon.count = n1;
+    p1.data.polygon.x = &coordinates[0];
+    p1.data.polygon.y = &coordinates[n1];
+
+    p2.type = POLYGON;
+    p2.data.polygon.count = n2;
+    p2.data.polygon.x = &coordinates[n1 * 2];
+    p2.data.polygon.y = &coordinates[n1 * 2 + n2];
+
+    for (int i = 0; i < n1; i++) {
+        p1.data.polygon.x[i] = (float) buffer1.x[buffer1.offset[first] + i];
+        p1.data.polygon.y[i] = (float) buffer1.y[buffer1.offset[first] + i];
+    }
+
+    for (int i = 0; i < n2; i++) {
+        p2.data.polygon.x[i] = (float) buffer2.x[buffer2.offset[second] + i];
+        p2.data.polygon.y[i] = (float) buffer2.y[buffer2.offset[second] + i];
+    }
+
+    return region_compute_overlap(&p1, &p2, bounds);
 
-    return cstr;
 }
 
-void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+// In the default mode the rasterizer snaps the vertices to integer coordinates
+// and places the mask at an integer offset, so the pixels that a region covers
+// do not depend on the region it is compared with. The coverage of a region
+// can therefore be rasterized once, within its own bounding box clipped to the
+// bounds, and stored as a list of column spans for every row. The overlap of
+// two regions is then computed by intersecting their spans. This is used to
+// cache the ground truth of a sequence, so that only the tracker region is
+// rasterized for every comparison. The legacy mode samples the polygons on a
+// grid that depends on both regions and can not be cached this way.
+//
+// The rasterizer computes scanline crossings in double precision relative to
+// the mask origin, so a crossing that falls exactly on a pixel boundary can be
+// rounded to either side depending on where the mask of a pair starts. Regions
+// with such a crossing, regions with a bounding box larger than SPANS_MAX_SIZE
+// and pairs with a larger union are therefore always scored with
+// region_compute_overlap, all other pairs get exactly the same pixel counts.
+
+// Checks that no scanline crossing of a polygon of the buffer (with vertices
+// rounded as in the default mode) lies exactly on a pixel boundary unless it
+// is also computed exactly.
+bool origin_invariant(const region_buffer& buffer, int index) {
+
+    int n = buffer.count[index];
+    const double* x = &buffer.x[buffer.offset[index]];
+    const double* y = &buffer.y[buffer.offset[index]];
+
+    for (int i = 0, j = n - 1; i < n; j = i++) {
+
+        float xi = roundf((float) x[i]), yi = roundf((float) y[i]);
+        float xj = roundf((float) x[j]), yj = roundf((float) y[j]);
+
+        double r = yj - yi, k = xj - xi;
+
+        if (r == 0 || k == 0) continue;
+
+        for (int py = (int) MIN(yi, yj) + 1; py < (int) MAX(yi, yj); py++) {
+            double m = py - yi;
+            if (fmod(m * k, r) == 0 && m / r * k != m * k / r)
+                return false;
+        }
 
-	if( nrhs < 2 ) mexErrMsgTxt("Two vector or cell arguments (regions) required (plus an optional argument with bounds).");
-	if( nlhs != 1 ) mexErrMsgTxt("Exactly one output argument required.");
+    }
 
-    region_bounds bounds = region_no_bounds;
+    return true;
 
-    if (nrhs > 2) {
-        bounds =  get_bounds(prhs[2]);
+}
+
+bool integer_bounds(region_bounds bounds) {
+
+    return floorf(bounds.left) == bounds.left && floorf(bounds.top) == bounds.top &&
+        floorf(bounds.right) == bounds.right && floorf(bounds.bottom) == bounds.bottom;
+
+}
+
+// Rasterizes a polygon of the buffer into spans within its bounding box
+// clipped to the bounds. Returns false if the box is too large.
+bool rasterize_spans(const region_buffer& buffer, int index, region_bounds bounds, region_spans& spans) {
+
+    int n = buffer.count[index];
+    std::vector<float> coordinates(n * 2);
+
+    region_container p;
+
+    p.type = POLYGON;
+    p.data.polygon.count = n;
+    p.data.polygon.x = &coordinates[0];
+    p.data.polygon.y = &coordinates[n];
+
+    region_bounds box;
+
+    for (int i = 0; i < n; i++) {
+        float x = (float) buffer.x[buffer.offset[index] + i];
+        float y = (float) buffer.y[buffer.offset[index] + i];
+        box.left = i ? MIN(box.left, x) : x; box.right = i ? MAX(box.right, x) : x;
+        box.top = i ? MIN(box.top, y) : y; box.bottom = i ? MAX(box.bottom, y) : y;
+        p.data.polygon.x[i] = x;
+        p.data.polygon.y[i] = y;
     }
 
-    region_clear_flags(REGION_LEGACY_RASTERIZATION);
-    if (nrhs > 3) {
-	    char* codestr = get_string(prhs[3]);
-	    if (strcmpi(codestr, "legacy") == 0)
-		    region_set_flags(REGION_LEGACY_RASTERIZATION);
-	    free(codestr);
+    box.left = MAX(floorf(box.left), bounds.left);
+    box.right = MIN(ceilf(box.right), bounds.right);
+    box.top = MAX(floorf(box.top), bounds.top);
+    box.bottom = MIN(ceilf(box.bottom), bounds.bottom);
+
+    spans.valid = false;
+    spans.box = box;
+    spans.top = (int) box.top;
+    spans.area = 0;
+    spans.rows.assign(1, 0);
+    spans.spans.clear();
+
+    if (box.right - box.left >= SPANS_MAX_SIZE || box.bottom - box.top >= SPANS_MAX_SIZE)
+        return false;
+
+    spans.valid = true;
+
+    if (box.right < box.left || box.bottom < box.top)
+        return true;
+
+    int left = (int) box.left;
+    int width = (int) (box.right - box.left) + 1;
+    int height = (int) (box.bottom - box.top) + 1;
+
+    std::vector<char> mask(width * height);
+
+    region_get_mask_offset(&p, &mask[0], left, spans.top, width, height);
+
+    spans.rows.resize(height + 1);
+
+    for (int j = 0; j < height; j++) {
+        const char* row = &mask[j * width];
+        for (int i = 0; i < width; i++) {
+            if (!row[i]) continue;
+            int begin = i;
+            while (i < width && row[i]) i++;
+            spans.spans.push_back(left + begin);
+            spans.spans.push_back(left + i);
+            spans.area += i - begin;
+        }
+        spans.rows[j + 1] = (int) spans.spans.size();
     }
 
-    if (mxIsCell(prhs[0]) && mxIsCell(prhs[1])) {
+    return true;
 
-        if ( MIN(mxGetM(prhs[0]), mxGetN(prhs[0])) != 1 ) mexErrMsgTxt("Cell array must be a vector");
-        if ( MIN(mxGetM(prhs[1]), mxGetN(prhs[1])) != 1 ) mexErrMsgTxt("Cell array must be a vector");
+}
 
-        if ( MAX(mxGetM(prhs[0]), mxGetN(prhs[0])) != MAX(mxGetM(prhs[1]), mxGetN(prhs[1])))
-            mexErrMsgTxt("Cell arrays must be of equal size");
+// Computes the overlap of two regions from their spans.
+region_overlap span_overlap(const region_spans& a, const region_spans& b) {
 
-        int num = MAX(mxGetM(prhs[0]), mxGetN(prhs[0]));
+    int heighta = (int) a.rows.size() - 1, heightb = (int) b.rows.size() - 1;
+    int top = MAX(a.top, b.top);
+    int bottom = MIN(a.top + heighta, b.top + heightb);
 
-        plhs[0] = mxCreateDoubleMatrix(num, 3, mxREAL);
-        double *result = (double*) mxGetPr(plhs[0]);
+    double intersection = 0;
 
-        for (int i = 0; i < num; i++) {
-            mxArray* r1 = mxGetCell (prhs[0], i);
-            mxArray* r2 = mxGetCell (prhs[1], i);
+    for (int j = top; j < bottom; j++) {
 
-            region_overlap overlap = compute_overlap(r1, r2, bounds);
+        int i = a.rows[j - a.top], ie = a.rows[j - a.top + 1];
+        int k = b.rows[j - b.top], ke = b.rows[j - b.top + 1];
 
-            if (overlap.overlap < 0) {
-                result[i] = mxGetNaN();
-                result[i + num] = mxGetNaN();
-                result[i + num * 2] = mxGetNaN();
-            } else {
-                result[i] = overlap.overlap;
-                result[i + num] = overlap.only1;
-                result[i + num * 2] = overlap.only2;
-            }
+        while (i < ie && k < ke) {
+            int begin = MAX(a.spans[i], b.spans[k]);
+            int end = MIN(a.spans[i + 1], b.spans[k + 1]);
+            if (end > begin) intersection += end - begin;
+            if (a.spans[i + 1] < b.spans[k + 1]) i += 2; else k += 2;
         }
 
+    }
+
+    region_overlap overlap;
+
+    float mask_1 = (float) (a.area - intersection);
+    float mask_2 = (float) (b.area - intersection);
+    float mask_union = (float) (a.area + b.area - intersection);
 
+    if (mask_union > 0) {
+        overlap.overlap = (float) intersection / mask_union;
+        overlap.only1 = mask_1 / mask_union;
+        overlap.only2 = mask_2 / mask_union;
     } else {
+        overlap.overlap = 0;
+        overlap.only1 = 0;
+        overlap.only2 = 0;
+    }
 
-        plhs[0] = mxCreateDoubleMatrix(1, 3, mxREAL);
-        double *result = (double*) mxGetPr(plhs[0]);
+    return overlap;
 
-        region_overlap overlap = compute_overlap(prhs[0], prhs[1], bounds);
-        if (overlap.overlap < 0) {
-            result[0] = mxGetNaN();
-            result[1] = mxGetNaN();
-            result[2] = mxGetNaN();
-        } else {
-            result[0] = overlap.overlap;
-            result[1] = overlap.only1;
-            result[2] = overlap.only2;
+}
+
+// Computes the overlap of two rasterized regions from their spans as it would
+// be computed by region_compute_overlap. Returns false if the union of their
+// boxes exceeds the size that is handled by the spans.
+bool compute_span_overlap(const region_spans& a, const region_spans& b, region_overlap* overlap) {
+
+    float x = MIN(a.box.left, b.box.left);
+    float y = MIN(a.box.top, b.box.top);
+
+    if (MAX(a.box.right, b.box.right) - x >= SPANS_MAX_SIZE || MAX(a.box.bottom, b.box.bottom) - y >= SPANS_MAX_SIZE)
+        return false;
+
+    *overlap = span_overlap(a, b);
+
+    return true;
+
+}
+
+// Masks are compared with other regions on their spans, a polygon is
+// rasterized within its own bounding box (the result does not depend on the
+// other region). In the exact mode every pixel of a mask is a unit square and
+// the intersection with a polygon is computed exactly, the mask is split into
+// rectangles (spans of consecutive rows with equal columns are merged) that
+// are intersected with the convex pieces of the polygon.
+
+void prepare_exact_mask(const region_spans& spans, exact_region& region) {
+
+    region.area = spans.area;
+    region.pieces.clear();
+    region.signs.clear();
+
+    int height = (int) spans.rows.size() - 1;
+    std::vector<int> open;
+
+    for (int j = 0; j <= height; j++) {
+
+        int begin = j < height ? spans.rows[j] : 0, end = j < height ? spans.rows[j + 1] : 0;
+        bool same = j > 0 && j < height && end - begin == spans.rows[j] - spans.rows[j - 1] &&
+            std::equal(spans.spans.begin() + begin, spans.spans.begin() + end, spans.spans.begin() + spans.rows[j - 1]);
+
+        if (same) continue;
+
+        // Close the rectangles of the previous run of equal rows
+        for (size_t k = 0; j > 0 && k < open.size(); k += 3) {
+            double left = open[k], right = open[k + 1], top = spans.top + open[k + 2], bottom = spans.top + j;
+            point corners[4] = { { left, top }, { right, top }, { right, bottom }, { left, bottom } };
+            region.pieces.push_back(contour(corners, corners + 4));
+            region.signs.push_back(1);
+        }
+
+        open.clear();
+
+        for (int k = begin; k < end; k += 2) {
+            open.push_back(spans.spans[k]);
+            open.push_back(spans.spans[k + 1]);
+            open.push_back(j);
         }
+
+    }
+
+}
+
+region_overlap compute_mask_overlap(const region_buffer& buffer1, int first, const region_buffer& buffer2, int second,
+    region_bounds bounds, overlap_mode mode) {
+
+    int mask1 = buffer1.mask[first], mask2 = buffer2.mask[second];
+
+    if (mask1 >= 0 && mask2 >= 0)
+        return span_overlap(buffer1.masks[mask1], buffer2.masks[mask2]);
+
+    if (mode == MODE_EXACT) {
+        exact_region r1, r2;
+        if (mask1 >= 0) prepare_exact_mask(buffer1.masks[mask1], r1); else prepare_exact_region(buffer1, first, bounds, r1);
+        if (mask2 >= 0) prepare_exact_mask(buffer2.masks[mask2], r2); else prepare_exact_region(buffer2, second, bounds, r2);
+        return combine_exact_regions(r1, r2);
+    }
+
+    region_spans spans;
+
+    if (!rasterize_spans(mask1 >= 0 ? buffer2 : buffer1, mask1 >= 0 ? second : first, bounds, spans)) {
+        // Regions that are too large to be rasterized are not scored, as in region_compute_overlap
+        region_overlap overlap;
+        overlap.overlap = 0;
+        overlap.only1 = 0;
+        overlap.only2 = 0;
+        return overlap;
+    }
+
+    return mask1 >= 0 ? span_overlap(buffer1.masks[mask1], spans) : span_overlap(spans, buffer2.masks[mask2]);
+
+}
+
+region_overlap compute_overlap(const region_buffer& buffer, const region_pair& pair, region_bounds bounds, overlap_mode mode) {
+
+    if (!region_buffer_valid(buffer, pair.first) || !region_buffer_valid(buffer, pair.second)) {
+        region_overlap overlap;
+        overlap.overlap = -1;
+        return overlap;
     }
 
+    if (buffer.mask[pair.first] >= 0 || buffer.mask[pair.second] >= 0)
+        return compute_mask_overlap(buffer, pair.first, buffer, pair.second, bounds, mode);
+
+    if (mode == MODE_EXACT)
+        return compute_exact_overlap(buffer, pair.first, pair.second, bounds);
+
+    return compute_raster_overlap(buffer, pair.first, buffer, pair.second, bounds);
+
+}
+
+// Axis-aligned rectangles are scored in closed form instead of being rasterized.
+// The rasterizer covers a rectangle with a product of one column and one row
+// interval of mask pixels, so the pixel counts of both regions and of their
+// intersection can be computed directly from the interval end-points. The
+// rules below follow the scanline fill of region.c for a four-vertex polygon
+// with corners [x0, x1] x [y0, y1] (as created by get_polygon) and the mask
+// that region_compute_overlap allocates (union of both bounding boxes clipped
+// to bounds). The cost of a pair is therefore independent of its area.
+//
+// For regions that fit within the rasterization mask the pixel counts are the
+// same as the ones produced by the rasterizer and the overlap, only1 and only2
+// values agree with the legacy and default mode to the last bit of the single
+// precision result. A difference (at most one pixel row or column per edge)
+// can only occur for corners that lie within float rounding error of a pixel
+// boundary, which bounds the absolute error of the overlap by
+// (width + height) / (width * height) for the smaller of the two rectangles.
+// In the exact mode the rectangles are intersected as continuous intervals.
+
+typedef struct rectangle_batch {
+    std::vector<int> index;
+    std::vector<double> x0a, x1a, y0a, y1a;
+    std::vector<double> x0b, x1b, y0b, y1b;
+} rectangle_batch;
+
+bool get_rectangle(const double* r, int l, double* corners, overlap_mode mode) {
+
+    if (l != 4)
+        return false;
+
+    for (int i = 0; i < 4; i++)
+        if (!mxIsFinite(r[i])) return false;
+
+    double extent = (mode == MODE_EXACT) ? 0 : 1;
+
+    corners[0] = r[0];
+    corners[1] = r[0] + r[2] - extent;
+    corners[2] = r[1];
+    corners[3] = r[1] + r[3] - extent;
+
+    return true;
+
+}
+
+void rectangle_batch_push(rectangle_batch& batch, int index, const double* a, const double* b) {
+
+    batch.index.push_back(index);
+    batch.x0a.push_back(a[0]); batch.x1a.push_back(a[1]);
+    batch.y0a.push_back(a[2]); batch.y1a.push_back(a[3]);
+    batch.x0b.push_back(b[0]); batch.x1b.push_back(b[1]);
+    batch.y0b.push_back(b[2]); batch.y1b.push_back(b[3]);
+
+}
+
+// Rounding without calls to the math library or branches, so that the loop
+// below can be vectorized. The results are the same as of floorf, ceilf and
+// roundf for values within the range of an integer.
+static inline float floor_value(float x) {
+    int t = (int) x;
+    return (float) (t - ((float) t > x));
+}
+
+static inline float ceil_value(float x) {
+    int t = (int) x;
+    return (float) (t + ((float) t < x));
+}
+
+static inline int round_value(float x) {
+    int t = (int) x;
+    float f = x - (float) t;
+    return t + (int) (f >= 0.5f) - (int) (f <= -0.5f);
+}
+
+// Column interval [lo, hi) covered by a rectangle with relative corners p0 and p1
+// in a mask of given size.
+template <int LEGACY>
+static inline void rectangle_columns(float p0, float p1, int size, int* lo, int* hi) {
+
+    if (LEGACY) {
+        int a = (int) MIN(p0, p1);
+        int b = (int) MAX(p0, p1);
+        *lo = MAX(a, 0);
+        *hi = (b > size) ? size - 1 : b;
+    } else {
+        int a = round_value(MIN(p0, p1));
+        int b = round_value(MAX(p0, p1));
+        *lo = MAX(a, 0);
+        *hi = MIN(b, size - 1) + 1;
+    }
+
+}
+
+// Row interval [lo, hi) covered by a rectangle with relative corners p0 and p1
+// in a mask of given size.
+template <int LEGACY>
+static inline void rectangle_rows(float p0, float p1, int size, int* lo, int* hi) {
+
+    int a, b;
+
+    if (LEGACY) {
+        a = (int) floor_value(MIN(p0, p1)) + 1;
+        b = (int) floor_value(MAX(p0, p1)) + 1;
+    } else {
+        a = round_value(MIN(p0, p1));
+        b = round_value(MAX(p0, p1));
+        b = (a == b) ? a : b + 1;
+    }
+
+    *lo = MAX(a, 0);
+    *hi = MIN(b, size);
+
+}
+
+// Scores all rectangle pairs in a batch. The batch is stored as a structure of
+// arrays, the rasterization mode is a template parameter and the loop body is
+// free of branches and library calls, so that the compiler can vectorize the
+// loop when optimizing for it (GCC does so at -O3, not at the default -O2 of mex).
+template <int LEGACY>
+void compute_rectangle_overlaps(const rectangle_batch& batch, region_bounds bounds, float* __restrict overlap, float* __restrict only1, float* __restrict only2) {
+
+    int count = (int) batch.index.size();
+
+    const double* x0a = batch.x0a.data(); const double* x1a = batch.x1a.data();
+    const double* y0a = batch.y0a.data(); const double* y1a = batch.y1a.data();
+    const double* x0b = batch.x0b.data(); const double* x1b = batch.x1b.data();
+    const double* y0b = batch.y0b.data(); const double* y1b = batch.y1b.data();
+
+    for (int i = 0; i < count; i++) {
+
+        // Region containers store coordinates in single precision
+        float xa0 = (float) x0a[i], xa1 = (float) x1a[i], ya0 = (float) y0a[i], ya1 = (float) y1a[i];
+        float xb0 = (float) x0b[i], xb1 = (float) x1b[i], yb0 = (float) y0b[i], yb1 = (float) y1b[i];
+
+        float la = MIN(xa0, xa1), ra = MAX(xa0, xa1);
+        float ta = MIN(ya0, ya1), ba = MAX(ya0, ya1);
+        float lb = MIN(xb0, xb1), rb = MAX(xb0, xb1);
+        float tb = MIN(yb0, yb1), bb = MAX(yb0, yb1);
+
+        if (!LEGACY) {
+            la = floor_value(la); ra = ceil_value(ra); ta = floor_value(ta); ba = ceil_value(ba);
+            lb = floor_value(lb); rb = ceil_value(rb); tb = floor_value(tb); bb = ceil_value(bb);
+        }
+
+        la = MAX(la, bounds.left); ra = MIN(ra, bounds.right);
+        ta = MAX(ta, bounds.top); ba = MIN(ba, bounds.bottom);
+        lb = MAX(lb, bounds.left); rb = MIN(rb, bounds.right);
+        tb = MAX(tb, bounds.top); bb = MIN(bb, bounds.bottom);
+
+        float ox = MIN(la, lb);
+        float oy = MIN(ta, tb);
+
+        int width = (int) (MAX(ra, rb) - ox) + 1;
+        int height = (int) (MAX(ba, bb) - oy) + 1;
+
+        int ca0, ca1, cb0, cb1, ra0, ra1, rb0, rb1;
+
+        rectangle_columns<LEGACY>(xa0 - ox, xa1 - ox, width, &ca0, &ca1);
+        rectangle_columns<LEGACY>(xb0 - ox, xb1 - ox, width, &cb0, &cb1);
+        rectangle_rows<LEGACY>(ya0 - oy, ya1 - oy, height, &ra0, &ra1);
+        rectangle_rows<LEGACY>(yb0 - oy, yb1 - oy, height, &rb0, &rb1);
+
+        double area1 = (double) MAX(ca1 - ca0, 0) * (double) MAX(ra1 - ra0, 0);
+        double area2 = (double) MAX(cb1 - cb0, 0) * (double) MAX(rb1 - rb0, 0);
+        double intersection = (double) MAX(MIN(ca1, cb1) - MAX(ca0, cb0), 0) *
+            (double) MAX(MIN(ra1, rb1) - MAX(ra0, rb0), 0);
+
+        float mask_1 = (float) (area1 - intersection);
+        float mask_2 = (float) (area2 - intersection);
+        float mask_union = (float) (area1 + area2 - intersection);
+
+        // Invalid pairs are divided by one and zeroed instead of skipped
+        float valid = (float) ((width > 0) & (height > 0) & (mask_union > 0));
+        float normalization = valid * mask_union + (1 - valid);
+
+        overlap[i] = valid * ((float) intersection / normalization);
+        only1[i] = valid * (mask_1 / normalization);
+        only2[i] = valid * (mask_2 / normalization);
+
+    }
+
+}
+
+void compute_exact_rectangle_overlaps(const rectangle_batch& batch, region_bounds bounds, float* overlap, float* only1, float* only2) {
+
+    int count = (int) batch.index.size();
+
+    const double* x0a = batch.x0a.data(); const double* x1a = batch.x1a.data();
+    const double* y0a = batch.y0a.data(); const double* y1a = batch.y1a.data();
+    const double* x0b = batch.x0b.data(); const double* x1b = batch.x1b.data();
+    const double* y0b = batch.y0b.data(); const double* y1b = batch.y1b.data();
+
+    double left = bounds.left, top = bounds.top;
+    double right = (double) bounds.right + 1, bottom = (double) bounds.bottom + 1;
+
+    for (int i = 0; i < count; i++) {
+
+        double la = MAX(MIN(x0a[i], x1a[i]), left), ra = MIN(MAX(x0a[i], x1a[i]), right);
+        double ta = MAX(MIN(y0a[i], y1a[i]), top), ba = MIN(MAX(y0a[i], y1a[i]), bottom);
+        double lb = MAX(MIN(x0b[i], x1b[i]), left), rb = MIN(MAX(x0b[i], x1b[i]), right);
+        double tb = MAX(MIN(y0b[i], y1b[i]), top), bb = MIN(MAX(y0b[i], y1b[i]), bottom);
+
+        double area1 = MAX(ra - la, 0) * MAX(ba - ta, 0);
+        double area2 = MAX(rb - lb, 0) * MAX(bb - tb, 0);
+        double intersection = MAX(MIN(ra, rb) - MAX(la, lb), 0) * MAX(MIN(ba, bb) - MAX(ta, tb), 0);
+        double total = area1 + area2 - intersection;
+
+        int valid = total > 0;
+        double normalization = valid ? total : 1;
+
+        overlap[i] = valid ? (float) (intersection / normalization) : 0;
+        only1[i] = valid ? (float) ((area1 - intersection) / normalization) : 0;
+        only2[i] = valid ? (float) ((area2 - intersection) / normalization) : 0;
+
+    }
+
+}
+
+void store_overlap(double* result, int i, int num, region_overlap overlap) {
+
+    if (overlap.overlap < 0) {
+        result[i] = mxGetNaN();
+        result[i + num] = mxGetNaN();
+        result[i + num * 2] = mxGetNaN();
+    } else {
+        result[i] = overlap.overlap;
+        result[i + num] = overlap.only1;
+        result[i + num * 2] = overlap.only2;
+    }
+
+}
+
+void store_rectangle_overlaps(double* result, int num, const rectangle_batch& batch, region_bounds bounds, overlap_mode mode) {
+
+    int count = (int) batch.index.size();
+
+    if (count == 0) return;
+
+    std::vector<float> overlap(count), only1(count), only2(count);
+
+    if (mode == MODE_EXACT)
+        compute_exact_rectangle_overlaps(batch, bounds, overlap.data(), only1.data(), only2.data());
+    else
+        if (mode == MODE_LEGACY)
+            compute_rectangle_overlaps<1>(batch, bounds, overlap.data(), only1.data(), only2.data());
+        else
+            compute_rectangle_overlaps<0>(batch, bounds, overlap.data(), only1.data(), only2.data());
+
+    for (int j = 0; j < count; j++) {
+        int i = batch.index[j];
+        result[i] = overlap[j];
+        result[i + num] = only1[j];
+        result[i + num * 2] = only2[j];
+    }
+
+}
+
+char* get_string(const mxArray *arg) {
+
+	if (mxGetM(arg) != 1)
+		mexErrMsgTxt("Must be an array of chars");
+
+    int l = (int) mxGetN(arg);
+
+    char* cstr = (char *) malloc(sizeof(char) * (l + 1));
+
+    mxGetString(arg, cstr, (l + 1));
+
+    return cstr;
+}
+
+int get_integer(const mxArray *arg) {
+
+	if (mxGetM(arg) != 1 || mxGetN(arg) != 1)
+		mexErrMsgTxt("Parameter must be a single value");
+
+    if (mxIsInt32(arg))
+        return ((int*)mxGetPr(arg))[0];
+
+    if (mxIsDouble(arg))
+        return (int) ((double*)mxGetPr(arg))[0];
+
+    return 0;
+}
+
+overlap_mode get_mode(const mxArray* arg) {
+
+    overlap_mode mode = MODE_DEFAULT;
+
+    if (arg) {
+	    char* codestr = get_string(arg);
+	    if (strcmpi(codestr, "legacy") == 0) {
+		    mode = MODE_LEGACY;
+	    } else if (strcmpi(codestr, "exact") == 0) {
+		    mode = MODE_EXACT;
+	    }
+	    free(codestr);
+    }
+
+    return mode;
+
+}
+
+void set_mode(overlap_mode mode) {
+
+    region_clear_flags(REGION_LEGACY_RASTERIZATION);
+
+    if (mode == MODE_LEGACY)
+        region_set_flags(REGION_LEGACY_RASTERIZATION);
+
+}
+
+// Rasterized ground truth of a sequence. The spans are shared by all sessions
+// that are opened for the same sequence name and are kept until the MEX
+// function is cleared. A cache is only reused if the mode, the bounds and the
+// checksum of the ground-truth values match. It can also be stored in a file
+// to be reused in a later session of MATLAB.
+
+#define SPANS_FILE_MAGIC 0x4e415053
+#define SPANS_FILE_VERSION 1
+
+typedef struct groundtruth_spans {
+    overlap_mode mode;
+    region_bounds bounds;
+    unsigned long long checksum;
+    std::vector<region_spans> frames;
+} groundtruth_spans;
+
+unsigned long long groundtruth_checksum(region_source& source) {
+
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (int i = 0; i < source.count; i++) {
+        int l;
+        const double* r = get_source_region(source, i, &l);
+        const unsigned char* bytes = (const unsigned char*) &l;
+        for (size_t j = 0; j < sizeof(int); j++) hash = (hash ^ bytes[j]) * 1099511628211ULL;
+        size_t size = l * sizeof(double);
+        bytes = (const unsigned char*) r;
+        if (l < 0) {
+            const rle_mask& mask = source.mask;
+            int header[4] = {mask.x, mask.y, mask.width, mask.height};
+            bytes = (const unsigned char*) header;
+            for (size_t j = 0; j < sizeof(header); j++) hash = (hash ^ bytes[j]) * 1099511628211ULL;
+            bytes = (const unsigned char*) mask.runs.data();
+            size = mask.runs.size() * sizeof(int);
+        }
+        for (size_t j = 0; j < size; j++) hash = (hash ^ bytes[j]) * 1099511628211ULL;
+    }
+
+    return hash;
+
+}
+
+bool matches_spans(const groundtruth_spans& cache, overlap_mode mode, region_bounds bounds, unsigned long long checksum, int count) {
+
+    return cache.mode == mode && cache.checksum == checksum && (int) cache.frames.size() == count &&
+        memcmp(&cache.bounds, &bounds, sizeof(region_bounds)) == 0;
+
+}
+
+bool load_spans(const char* filename, groundtruth_spans& cache) {
+
+    FILE* file = fopen(filename, "rb");
+
+    if (!file) return false;
+
+    int header[4], count = 0;
+    bool success = fread(header, sizeof(int), 4, file) == 4 && header[0] == SPANS_FILE_MAGIC && header[1] == SPANS_FILE_VERSION;
+
+    if (success) {
+        cache.mode = (overlap_mode) header[2];
+        count = header[3];
+        success = fread(&cache.bounds, sizeof(region_bounds), 1, file) == 1 &&
+            fread(&cache.checksum, sizeof(unsigned long long), 1, file) == 1 && count >= 0;
+    }
+
+    cache.frames.resize(success ? count : 0);
+
+    for (int i = 0; success && i < count; i++) {
+        region_spans& spans = cache.frames[i];
+        int values[5];
+        success = fread(values, sizeof(int), 5, file) == 5 && fread(&spans.box, sizeof(region_bounds), 1, file) == 1 &&
+            values[3] >= 1 && values[4] >= 0;
+        if (!success) break;
+        spans.valid = values[0] != 0;
+        spans.top = values[1];
+        spans.area = values[2];
+        spans.rows.resize(values[3]);
+        spans.spans.resize(values[4]);
+        success = fread(&spans.rows[0], sizeof(int), values[3], file) == (size_t) values[3] &&
+            (values[4] == 0 || fread(&spans.spans[0], sizeof(int), values[4], file) == (size_t) values[4]) &&
+            spans.rows[0] == 0 && spans.rows[values[3] - 1] == values[4];
+    }
+
+    fclose(file);
+
+    return success;
+
+}
+
+// The spans are written to a temporary file that is renamed, so concurrent
+// readers see either the old or the new file.
+void save_spans(const char* filename, const groundtruth_spans& cache) {
+
+    static std::atomic<unsigned int> counter(0);
+
+    char suffix[64];
+    sprintf(suffix, ".%u.%u.tmp", (unsigned int) getpid(), counter++);
+    std::string temporary = std::string(filename) + suffix;
+
+    FILE* file = fopen(temporary.c_str(), "wb");
+
+    if (!file) return;
+
+    int header[4] = {SPANS_FILE_MAGIC, SPANS_FILE_VERSION, (int) cache.mode, (int) cache.frames.size()};
+
+    bool success = fwrite(header, sizeof(int), 4, file) == 4 &&
+        fwrite(&cache.bounds, sizeof(region_bounds), 1, file) == 1 &&
+        fwrite(&cache.checksum, sizeof(unsigned long long), 1, file) == 1;
+
+    for (size_t i = 0; success && i < cache.frames.size(); i++) {
+        const region_spans& spans = cache.frames[i];
+        int values[5] = {spans.valid, spans.top, spans.area, (int) spans.rows.size(), (int) spans.spans.size()};
+        success = fwrite(values, sizeof(int), 5, file) == 5 && fwrite(&spans.box, sizeof(region_bounds), 1, file) == 1 &&
+            fwrite(&spans.rows[0], sizeof(int), values[3], file) == (size_t) values[3] &&
+            (values[4] == 0 || fwrite(&spans.spans[0], sizeof(int), values[4], file) == (size_t) values[4]);
+    }
+
+    success = fclose(file) == 0 && success;
+
+#if defined(_WIN32)
+    if (success) remove(filename);
+#endif
+
+    if (!success || rename(temporary.c_str(), filename) != 0)
+        remove(temporary.c_str());
+
+}
+
+// An overlap session holds the ground-truth trajectory of a sequence for the
+// duration of a tracker run, so that the experiment callback only passes the
+// tracker region and the frame index for every frame. The ground truth is
+// parsed once, rectangles are kept as corners for the closed form and, in the
+// exact mode, polygons are clipped to the bounds and split into convex pieces
+// when the session is opened. In the default mode the ground truth is
+// rasterized into spans that can be shared between sessions (see above).
+
+typedef struct overlap_session {
+    overlap_mode mode;
+    region_bounds bounds;
+    region_buffer groundtruth;
+    std::vector<double> corners;
+    std::vector<char> rectangle;
+    std::vector<exact_region> exact;
+    std::shared_ptr<groundtruth_spans> spans;
+} overlap_session;
+
+// Worker threads, sessions and cached ground truth are kept alive between
+// calls and released when the MEX function is cleared.
+static thread_pool pool;
+static std::map<int, overlap_session*> sessions;
+static std::map<std::string, std::shared_ptr<groundtruth_spans> > caches;
+static int session_counter = 0;
+
+static void release_resources() {
+
+    pool.resize(0);
+
+    for (std::map<int, overlap_session*>::iterator it = sessions.begin(); it != sessions.end(); it++)
+        delete it->second;
+
+    sessions.clear();
+    caches.clear();
+
+}
+
+overlap_session* get_session(const mxArray* arg) {
+
+    std::map<int, overlap_session*>::iterator it = sessions.find(get_integer(arg));
+
+    if (it == sessions.end())
+        mexErrMsgTxt("Unknown overlap session");
+
+    return it->second;
+
+}
+
+// Spans of the same ground truth are cached separately for every mode and
+// bounds, so sessions with different settings do not evict each other.
+std::string spans_key(const char* name, overlap_mode mode, region_bounds bounds) {
+
+    char suffix[128];
+    sprintf(suffix, "|%d|%g,%g,%g,%g", (int) mode, bounds.top, bounds.bottom, bounds.left, bounds.right);
+
+    return std::string(name) + suffix;
+
+}
+
+// Returns the spans of the ground truth of a session, either from the cache
+// of the given name, from a file or by rasterizing the ground truth.
+std::shared_ptr<groundtruth_spans> get_spans(const overlap_session* session, region_source& source, const char* name, const char* filename) {
+
+    unsigned long long checksum = groundtruth_checksum(source);
+    int count = source.count;
+    std::string key = name ? spans_key(name, session->mode, session->bounds) : std::string();
+
+    if (name) {
+        std::map<std::string, std::shared_ptr<groundtruth_spans> >::iterator it = caches.find(key);
+        if (it != caches.end() && matches_spans(*it->second, session->mode, session->bounds, checksum, count))
+            return it->second;
+    }
+
+    std::shared_ptr<groundtruth_spans> cache(new groundtruth_spans());
+
+    if (!filename || !load_spans(filename, *cache) || !matches_spans(*cache, session->mode, session->bounds, checksum, count)) {
+
+        cache->mode = session->mode;
+        cache->bounds = session->bounds;
+        cache->checksum = checksum;
+        cache->frames.resize(count);
+
+        for (int i = 0; i < count; i++) {
+            region_spans& spans = cache->frames[i];
+            if (session->groundtruth.count[i] > 0 && origin_invariant(session->groundtruth, i)) {
+                rasterize_spans(session->groundtruth, i, session->bounds, spans);
+            } else {
+                spans.valid = false;
+                spans.box = session->bounds;
+                spans.top = 0;
+                spans.area = 0;
+                spans.rows.assign(1, 0);
+            }
+        }
+
+        if (filename) save_spans(filename, *cache);
+
+    }
+
+    if (name) caches[key] = cache;
+
+    return cache;
+
+}
+
+int open_session(const mxArray* groundtruth, region_bounds bounds, overlap_mode mode, const char* name, const char* filename) {
+
+    if (!mxIsCell(groundtruth) && mxGetClassID(groundtruth) != mxDOUBLE_CLASS)
+        mexErrMsgTxt("Ground truth must be given as a cell array or as a matrix of doubles");
+
+    region_source source;
+
+    get_source(source, groundtruth, NULL, true);
+
+    overlap_session* session = new overlap_session();
+
+    session->mode = mode;
+    session->bounds = bounds;
+    session->corners.resize(source.count * 4);
+    session->rectangle.resize(source.count);
+
+    for (int i = 0; i < source.count; i++) {
+        int l;
+        const double* r = get_source_region(source, i, &l);
+        session->rectangle[i] = get_rectangle(r, l, &session->corners[i * 4], mode);
+        if (l < 0)
+            region_buffer_push_mask(session->groundtruth, source.mask, bounds);
+        else
+            region_buffer_push(session->groundtruth, r, l, mode);
+    }
+
+    if (mode == MODE_EXACT) {
+        session->exact.resize(source.count);
+        for (int i = 0; i < source.count; i++)
+            if (session->groundtruth.count[i] > 0)
+                prepare_exact_region(session->groundtruth, i, bounds, session->exact[i]);
+    }
+
+    if (mode == MODE_DEFAULT && integer_bounds(bounds)) {
+        set_mode(mode);
+        session->spans = get_spans(session, source, name, filename);
+    }
+
+    sessions[++session_counter] = session;
+
+    return session_counter;
+
+}
+
+// Computes the overlap of a region of the buffer (pair.first) with the ground
+// truth of the session at a frame (pair.second). Does not use the MEX API.
+region_overlap compute_session_overlap(const overlap_session* session, const region_buffer& buffer, const region_pair& pair) {
+
+    int index = pair.first, frame = pair.second;
+
+    if (!region_buffer_valid(buffer, index) || !region_buffer_valid(session->groundtruth, frame)) {
+        region_overlap overlap;
+        overlap.overlap = -1;
+        return overlap;
+    }
+
+    if (buffer.mask[index] >= 0 || session->groundtruth.mask[frame] >= 0)
+        return compute_mask_overlap(buffer, index, session->groundtruth, frame, session->bounds, session->mode);
+
+    if (session->mode == MODE_EXACT) {
+        exact_region region;
+        prepare_exact_region(buffer, index, session->bounds, region);
+        return combine_exact_regions(region, session->exact[frame]);
+    }
+
+    if (session->spans && session->spans->frames[frame].valid) {
+        region_spans spans;
+        region_overlap overlap;
+        if (origin_invariant(buffer, index) && rasterize_spans(buffer, index, session->bounds, spans) &&
+            compute_span_overlap(spans, session->spans->frames[frame], &overlap))
+            return overlap;
+    }
+
+    return compute_raster_overlap(buffer, index, session->groundtruth, frame, session->bounds);
+
+}
+
+void query_session(const overlap_session* session, const mxArray* input, const mxArray* frames, int threads, mxArray** output) {
+
+    bool batch = mxIsCell(input) || mxGetM(input) != 1;
+
+    region_source source;
+
+    get_source(source, input, NULL, batch);
+
+    int num = source.count;
+
+    if (frames && !mxIsEmpty(frames) && (mxGetClassID(frames) != mxDOUBLE_CLASS || (int) mxGetNumberOfElements(frames) != num))
+        mexErrMsgTxt("Frame indices must be a vector of doubles with one value per region");
+
+    const double* indices = (frames && !mxIsEmpty(frames)) ? (double*) mxGetPr(frames) : NULL;
+
+    set_mode(session->mode);
+
+    *output = mxCreateDoubleMatrix(num, 3, mxREAL);
+    double *result = (double*) mxGetPr(*output);
+
+    rectangle_batch rectangles;
+    region_buffer regions;
+    std::vector<region_pair> pairs;
+    double corners[4];
+
+    for (int i = 0; i < num; i++) {
+
+        int frame = indices ? (int) indices[i] : i + 1;
+
+        if (frame < 1 || frame > (int) session->rectangle.size())
+            mexErrMsgTxt("Frame index out of range");
+
+        frame--;
+
+        int l;
+        const double* r = get_source_region(source, i, &l);
+
+        if (session->rectangle[frame] && get_rectangle(r, l, corners, session->mode)) {
+            rectangle_batch_push(rectangles, i, corners, &session->corners[frame * 4]);
+            continue;
+        }
+
+        region_pair pair;
+        pair.index = i;
+        pair.first = l < 0 ? region_buffer_push_mask(regions, source.mask, session->bounds) : region_buffer_push(regions, r, l, session->mode);
+        pair.second = frame;
+        pairs.push_back(pair);
+
+    }
+
+    std::vector<region_overlap> overlaps(pairs.size());
+
+    pool.run((int) pairs.size(), threads, 8, [&](int i) {
+        overlaps[i] = compute_session_overlap(session, regions, pairs[i]);
+    });
+
+    for (size_t i = 0; i < pairs.size(); i++)
+        store_overlap(result, pairs[i].index, num, overlaps[i]);
+
+    store_rectangle_overlaps(result, num, rectangles, session->bounds, session->mode);
+
+}
+
+// Handles session commands: region_overlap('open', groundtruth, bounds, mode,
+// name, file) returns a session handle, the optional name and file identify
+// the cached ground truth. region_overlap('query', session, regions, frames,
+// threads) returns the overlaps of one or more regions with the ground truth
+// at the given frames (all frames from the first one by default) and
+// region_overlap('close', session) releases the session.
+void session_command(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+    char* command = get_string(prhs[0]);
+
+    int code = strcmpi(command, "open") == 0 ? 1 : (strcmpi(command, "query") == 0 ? 2 : (strcmpi(command, "close") == 0 ? 3 : 0));
+
+    free(command);
+
+    if (code == 1) {
+
+        if( nrhs < 2 ) mexErrMsgTxt("Ground truth argument required (plus optional bounds, mode, cache name and cache file).");
+        if( nlhs != 1 ) mexErrMsgTxt("Exactly one output argument required.");
+
+        region_bounds bounds = nrhs > 2 ? get_bounds(prhs[2]) : region_no_bounds;
+        overlap_mode mode = get_mode(nrhs > 3 ? prhs[3] : NULL);
+        char* name = (nrhs > 4 && !mxIsEmpty(prhs[4])) ? get_string(prhs[4]) : NULL;
+        char* filename = (nrhs > 5 && !mxIsEmpty(prhs[5])) ? get_string(prhs[5]) : NULL;
+
+        plhs[0] = mxCreateDoubleScalar(open_session(prhs[1], bounds, mode, name, filename));
+
+        if (name) free(name);
+        if (filename) free(filename);
+
+    } else if (code == 2) {
+
+        if( nrhs < 3 ) mexErrMsgTxt("Session and region arguments required (plus optional frame indices and number of threads).");
+        if( nlhs != 1 ) mexErrMsgTxt("Exactly one output argument required.");
+
+        overlap_session* session = get_session(prhs[1]);
+
+        query_session(session, prhs[2], nrhs > 3 ? prhs[3] : NULL, nrhs > 4 ? get_integer(prhs[4]) : 1, &plhs[0]);
+
+    } else if (code == 3) {
+
+        if( nrhs != 2 ) mexErrMsgTxt("Session argument required.");
+
+        overlap_session* session = get_session(prhs[1]);
+
+        sessions.erase(get_integer(prhs[1]));
+
+        delete session;
+
+    } else {
+        mexErrMsgTxt("Unknown command");
+    }
+
+}
+
+// Scores all non-rectangle pairs, in parallel if more than one thread is
+// requested. Every pair is computed independently by the same code, so the
+// result does not depend on the number of threads.
+void store_overlaps(double* result, int num, const region_buffer& regions, const std::vector<region_pair>& pairs,
+    region_bounds bounds, overlap_mode mode, int threads) {
+
+    int count = (int) pairs.size();
+
+    if (count == 0) return;
+
+    std::vector<region_overlap> overlaps(count);
+
+    pool.run(count, threads, 8, [&](int i) {
+        overlaps[i] = compute_overlap(regions, pairs[i], bounds, mode);
+    });
+
+    for (int i = 0; i < count; i++)
+        store_overlap(result, pairs[i].index, num, overlaps[i]);
+
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+    mexAtExit(release_resources);
+
+    if( nrhs > 0 && mxIsChar(prhs[0]) ) {
+        session_command(nlhs, plhs, nrhs, prhs);
+        return;
+    }
+
+	if( nrhs < 2 ) mexErrMsgTxt("Two vector, matrix or cell arguments (regions) required (plus an optional argument with bounds).");
+	if( nlhs != 1 ) mexErrMsgTxt("Exactly one output argument required.");
+
+    region_bounds bounds = region_no_bounds;
+
+    if (nrhs > 2) {
+        bounds =  get_bounds(prhs[2]);
+    }
+
+    overlap_mode mode = get_mode(nrhs > 3 ? prhs[3] : NULL);
+
+    set_mode(mode);
+
+    int threads = 1;
+
+    if (nrhs > 4) {
+        threads = get_integer(prhs[4]);
+    }
+
+    bool batch = mxIsCell(prhs[0]) || mxIsCell(prhs[1]) || mxGetM(prhs[0]) > 1 || mxGetM(prhs[1]) > 1;
+
+    region_source source1, source2;
+
+    get_source(source1, prhs[0], nrhs > 5 ? prhs[5] : NULL, batch);
+    get_source(source2, prhs[1], nrhs > 6 ? prhs[6] : NULL, batch);
+
+    if (source1.count != source2.count)
+        mexErrMsgTxt("Region arrays must be of equal size");
+
+    int num = source1.count;
+
+    plhs[0] = mxCreateDoubleMatrix(num, 3, mxREAL);
+    double *result = (double*) mxGetPr(plhs[0]);
+
+    rectangle_batch rectangles;
+    region_buffer regions;
+    std::vector<region_pair> pairs;
+    double a[4], b[4];
+
+    for (int i = 0; i < num; i++) {
+        int l1, l2;
+        const double* r1 = get_source_region(source1, i, &l1);
+        const double* r2 = get_source_region(source2, i, &l2);
+
+        if (get_rectangle(r1, l1, a, mode) && get_rectangle(r2, l2, b, mode)) {
+            rectangle_batch_push(rectangles, i, a, b);
+            continue;
+        }
+
+        region_pair pair;
+        pair.index = i;
+        pair.first = l1 < 0 ? region_buffer_push_mask(regions, source1.mask, bounds) : region_buffer_push(regions, r1, l1, mode);
+        pair.second = l2 < 0 ? region_buffer_push_mask(regions, source2.mask, bounds) : region_buffer_push(regions, r2, l2, mode);
+        pairs.push_back(pair);
+    }
+
+    store_overlaps(result, num, regions, pairs, bounds, mode, threads);
+    store_rectangle_overlaps(result, num, rectangles, bounds, mode);
+
 }
 
@@ -0,0 +1,224 @@
+// region_rle.h
+// Segmentation mask regions encoded with run-lengths, shared by the native
+// region components of the toolkit.
+//
+// In MATLAB a mask region is an int32 row vector [x, y, width, height, r1, r2,
+// ...] where the runs cover the width x height box with the top-left corner at
+// (x, y) in row-major order. The runs alternate between background and
+// foreground pixels and start with background (the first run can be zero),
+// pixels that are not covered by the runs are background. In trajectory files
+// a mask is written as the same list of values prefixed with the letter m,
+// e.g. m10,20,3,2,1,4 is a 3 x 2 box at (10, 20) with the first pixel empty.
+
+#ifndef TOOLKIT_REGION_RLE_H
+#define TOOLKIT_REGION_RLE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+
+#include "mex.h"
+#include "region.h"
+
+typedef struct rle_mask {
+    int x;
+    int y;
+    int width;
+    int height;
+    std::vector<int> runs;
+} rle_mask;
+
+static inline bool rle_mask_valid(const rle_mask& mask) {
+
+    if (mask.width < 0 || mask.height < 0)
+        return false;
+
+    long long total = 0;
+
+    for (size_t i = 0; i < mask.runs.size(); i++) {
+        if (mask.runs[i] < 0) return false;
+        total += mask.runs[i];
+    }
+
+    return total <= (long long) mask.width * (long long) mask.height;
+
+}
+
+// Creates a mask from a list of values [x, y, width, height, r1, ...].
+static inline bool rle_mask_from_values(const double* values, int length, rle_mask& mask) {
+
+    if (length < 4)
+        return false;
+
+    for (int i = 0; i < length; i++)
+        if (!mxIsFinite(values[i]) || values[i] != floor(values[i]) || fabs(values[i]) > 2147483647.0) return false;
+
+    mask.x = (int) values[0];
+    mask.y = (int) values[1];
+    mask.width = (int) values[2];
+    mask.height = (int) values[3];
+    mask.runs.resize(length - 4);
+
+    for (int i = 4; i < length; i++)
+        mask.runs[i - 4] = (int) values[i];
+
+    return rle_mask_valid(mask);
+
+}
+
+// Reads a mask from an int32 vector, returns false if the array is not a valid mask.
+static inline bool rle_mask_from_array(const mxArray* input, rle_mask& mask) {
+
+    if (!mxIsInt32(input) || mxGetNumberOfDimensions(input) > 2 || MIN(mxGetM(input), mxGetN(input)) != 1)
+        return false;
+
+    int length = (int) mxGetNumberOfElements(input);
+    const int* values = (const int*) mxGetData(input);
+
+    if (length < 4)
+        return false;
+
+    mask.x = values[0];
+    mask.y = values[1];
+    mask.width = values[2];
+    mask.height = values[3];
+    mask.runs.assign(values + 4, values + length);
+
+    return rle_mask_valid(mask);
+
+}
+
+static inline mxArray* rle_mask_to_array(const rle_mask& mask) {
+
+    mxArray* val = mxCreateNumericMatrix(1, 4 + mask.runs.size(), mxINT32_CLASS, mxREAL);
+    int* p = (int*) mxGetData(val);
+
+    p[0] = mask.x;
+    p[1] = mask.y;
+    p[2] = mask.width;
+    p[3] = mask.height;
+
+    for (size_t i = 0; i < mask.runs.size(); i++)
+        p[4 + i] = mask.runs[i];
+
+    return val;
+
+}
+
+// Parses a mask in the text format, returns false if the text is not a mask.
+static inline bool rle_mask_parse(const char* text, rle_mask& mask) {
+
+    while (*text == ' ' || *text == '\t') text++;
+
+    if (*text != 'm' && *text != 'M')
+        return false;
+
+    text++;
+
+    std::vector<double> values;
+
+    while (true) {
+
+        char* end;
+        double value = strtod(text, &end);
+
+        if (end == text)
+            return false;
+
+        values.push_back(value);
+
+        while (*end == ' ' || *end == '\t') end++;
+
+        if (*end == ',') {
+            text = end + 1;
+            continue;
+        }
+
+        if (*end == '\0' || *end == '\r' || *end == '\n')
+            break;
+
+        return false;
+
+    }
+
+    return rle_mask_from_values(&values[0], (int) values.size(), mask);
+
+}
+
+static inline std::string rle_mask_string(const rle_mask& mask) {
+
+    char buffer[64];
+    std::string result;
+
+    sprintf(buffer, "m%d,%d,%d,%d", mask.x, mask.y, mask.width, mask.height);
+    result += buffer;
+
+    for (size_t i = 0; i < mask.runs.size(); i++) {
+        sprintf(buffer, ",%d", mask.runs[i]);
+        result += buffer;
+    }
+
+    return result;
+
+}
+
+// Calls function(row, begin, end) for every foreground run within a row of
+// the mask in row-major order, row and columns are in absolute coordinates and
+// the end column is exclusive.
+template <typename F> void rle_mask_iterate(const rle_mask& mask, F function) {
+
+    if (mask.width == 0) return;
+
+    long long position = 0;
+
+    for (size_t i = 0; i < mask.runs.size(); i++) {
+
+        long long end = position + mask.runs[i];
+
+        if (i % 2 == 1) {
+            while (position < end) {
+                int row = (int) (position / mask.width);
+                int column = (int) (position % mask.width);
+                int length = (int) MIN(end - position, (long long) (mask.width - column));
+                function(mask.y + row, mask.x + column, mask.x + column + length);
+                position += length;
+            }
+        }
+
+        position = end;
+
+    }
+
+}
+
+// Encodes a row-major mask of a box with the top-left corner at (x, y).
+static inline void rle_mask_encode(const char* data, int x, int y, int width, int height, rle_mask& mask) {
+
+    mask.x = x;
+    mask.y = y;
+    mask.width = width;
+    mask.height = height;
+    mask.runs.clear();
+
+    char current = 0;
+    int length = 0;
+
+    for (long long i = 0; i < (long long) width * height; i++) {
+        char value = data[i] ? 1 : 0;
+        if (value != current) {
+            mask.runs.push_back(length);
+            current = value;
+            length = 0;
+        }
+        length++;
+    }
+
+    // Trailing background does not have to be stored
+    if (current)
+        mask.runs.push_back(length);
+
+}
+
+#endif
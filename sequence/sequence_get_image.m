@@ -1,10 +1,12 @@
-function [image_paths] = sequence_get_image(sequence, index, channels)
+function [image_paths] = sequence_get_image(sequence, index, channels, prefetch)
 % sequence_image_path Returns image path for the given sequence
 %
 % Input:
 % - sequence: A valid sequence structure.
 % - index: A index of a frame.
 % - channels: Which channels to retrieve.
+% - prefetch: An optional prefetcher of the sequence (see sequence_prefetch) that is
+%   notified that the images of the frame are about to be read.
 %
 % Output:
 % - image_paths: An image parh for the requested frame or an empty matrix if the frame number is invalid.
@@ -21,6 +23,10 @@ if ~iscell(channels)
     channels = {channels};
 end;
 
+if nargin > 3 && ~isempty(prefetch) && numel(index) == 1
+    frame_prefetch('advance', prefetch, index);
+end;
+
 if isfield(sequence, 'format')
     sequence_function = str2func(['sequence_get_image_', sequence.format]);
     image_paths = sequence_function(sequence, index, channels);
@@ -0,0 +1,46 @@
+function session = sequence_overlap_session(sequence, bounds, mode)
+% sequence_overlap_session Opens an overlap session for the groundtruth of a sequence
+%
+% Opens a region_overlap session that holds the groundtruth of the sequence so that
+% the overlap of a tracker region with the groundtruth can be computed by passing only
+% the region and the frame index. In the default rasterization mode the rasterized
+% groundtruth is shared by all sessions for the same sequence and is stored in the
+% workspace cache directory so that it can be reused later.
+%
+% Cache notice: The results of this function are cached in the workspace cache directory.
+%
+% Input:
+% - sequence (structure): A valid sequence structure.
+% - bounds (vector): An optional bounds of valid region where the overlap is calculated.
+% - mode (string): An optional overlap mode (default, legacy or exact).
+%
+% Output:
+% - session (integer): A session handle that has to be released with region_overlap('close', session).
+
+if nargin < 2
+    bounds = [];
+end
+
+if nargin < 3
+    mode = 'default';
+end
+
+cache_file = [];
+
+directory = get_global_variable('directory', []);
+
+if strcmp(mode, 'default') && ~isempty(directory)
+    cache_directory = fullfile(directory, 'cache', 'overlap');
+    if mkpath(cache_directory)
+        % Bounded and unbounded spans are stored separately
+        if isempty(bounds)
+            cache_file = fullfile(cache_directory, sprintf('%s.bin', sequence.name));
+        else
+            cache_file = fullfile(cache_directory, sprintf('%s_%s.bin', sequence.name, ...
+                strjoin(arrayfun(@(b) sprintf('%g', b), bounds(:)', 'UniformOutput', false), '_')));
+        end;
+    end;
+end;
+
+session = region_overlap('open', sequence_get_region(sequence), bounds, mode, sequence.name, cache_file);
+
@@ -0,0 +1,36 @@
+function prefetch = sequence_prefetch(sequence, channels)
+% sequence_prefetch Starts prefetching the images of a sequence
+%
+% Starts a frame_prefetch prefetcher for the images of the given channels of a
+% sequence. While the tracker processes a frame, the images of the following
+% frames are read into the page cache in the background so that the time of
+% reading them from a slow file system is not attributed to the tracker. The
+% number of frames that are prefetched ahead is set by the global variable
+% prefetch_frames (zero only counts the frames that were already cached), the
+% global variable prefetch_mode selects between asking the kernel to read the
+% files ('advise') and reading them in the background ('read').
+%
+% Input:
+% - sequence (structure): A valid sequence structure.
+% - channels (cell): Channels that are read by the tracker.
+%
+% Output:
+% - prefetch (integer): A prefetcher handle that is passed to sequence_get_image and
+%   released with frame_prefetch('close', prefetch), empty if prefetching is not
+%   available for the sequence.
+
+prefetch = [];
+
+% Sequences in a custom format resolve their images in their own functions
+if isfield(sequence, 'format') || sequence.length < 1
+    return;
+end;
+
+files = sequence_get_image(sequence, 1:sequence.length, channels);
+
+if ~iscell(files)
+    files = {files};
+end;
+
+prefetch = frame_prefetch('open', files, get_global_variable('prefetch_frames', 8), ...
+    get_global_variable('prefetch_mode', 'advise'));
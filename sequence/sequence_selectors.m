@@ -54,16 +54,20 @@ function results = results_for_sequence(experiment, tracker, sequences, i)
 
     directory = fullfile(tracker.directory, experiment.name, sequences{i}.name);
 
-    for j = 1:repeat
+    result_files = arrayfun(@(j) fullfile(directory, sprintf('%s_%03d.txt', sequences{i}.name, j)), ...
+        1:repeat, 'UniformOutput', false);
 
-        result_file = fullfile(directory, sprintf('%s_%03d.txt', sequences{i}.name, j));
+    [trajectories, status] = read_trajectories(result_files, ...
+        get_global_variable('native_threads', 0), 'cell', trajectory_cache());
 
-        try
-            trajectory = read_trajectory(result_file);
-        catch
+    for j = 1:repeat
+
+        if ~status(j)
             continue;
         end;
 
+        trajectory = trajectories{j};
+
         if (size(trajectory, 1) < size(groundtruth, 1))
             print_debug('Warning: Trajectory too short. Expanding with empty frames.');
             trajectory(end+1:length(groundtruth)) = {0};
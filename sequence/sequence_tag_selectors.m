@@ -71,7 +71,7 @@ function [results] = results_for_tag(experiment, tracker, sequences, tag)
             result_file = fullfile(directory, sprintf('%s_%03d.txt', sequences{s}.name, j));
 
             try
-                trajectory = read_trajectory(result_file);
+                trajectory = read_trajectory(result_file, 'cell', trajectory_cache());
 
                 if (size(results{s, j}, 1) < size(groundtruth, 1))
                     %print_debug('Warning: Trajectory too short. Expanding with empty frames.');
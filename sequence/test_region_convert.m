@@ -0,0 +1,27 @@
+function test_region_convert()
+% test_region_convert Tests conversion of masks with region_convert
+%
+% Converts a mask to a rectangle, a polygon and a rotated rectangle (the first two
+% also in a batch of regions) and checks that the bounding box of the mask is returned.
+% An error is raised if a conversion does not give the expected result.
+
+mask = region_convert([2, 3, 3, 2], 'mask');
+
+assert(isequal(region_convert(mask, 'rectangle'), [2, 3, 3, 2]), ...
+    'Mask not converted to its bounding rectangle');
+assert(isequal(region_convert(mask, 'polygon'), [2, 3, 5, 3, 5, 5, 2, 5]), ...
+    'Mask not converted to the polygon of its bounding box');
+assert(isequal(region_convert(mask, 'rotated'), [2, 3, 5, 3, 5, 5, 2, 5]), ...
+    'Mask not converted to the rotated rectangle of its pixels');
+
+batch = region_convert({mask, [1, 1, 4, 4]}, 'rectangle');
+
+assert(isequal(batch{1}, [2, 3, 3, 2]) && isequal(batch{2}, [1, 1, 4, 4]), ...
+    'Batch with a mask not converted to rectangles');
+
+batch = region_convert({mask, 1}, 'polygon');
+
+assert(isequal(batch{1}, [2, 3, 5, 3, 5, 5, 2, 5]) && isequal(batch{2}, 1), ...
+    'Batch with a mask not converted to polygons');
+
+print_text('Mask conversion tests passed.');
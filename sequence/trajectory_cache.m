@@ -0,0 +1,29 @@
+function cache = trajectory_cache()
+% trajectory_cache Returns the cache argument of the trajectory readers
+%
+% Returns the directory where read_trajectory and read_trajectories store the
+% binary sidecars of trajectory files, so that the result directories only
+% contain results. The sidecars are stored in the trajectories subdirectory of
+% the workspace cache if the global variable trajectory_cache is set (the
+% default), otherwise or without a workspace the cache is disabled.
+%
+% Cache notice: The results of this function are cached in the workspace cache directory.
+%
+% Output:
+% - cache (string or boolean): A cache directory or false if the cache is disabled.
+
+cache = false;
+
+directory = get_global_variable('directory', []);
+
+if ~get_global_variable('trajectory_cache', true) || isempty(directory)
+    return;
+end;
+
+cache_directory = fullfile(directory, 'cache', 'trajectories');
+
+if mkpath(cache_directory)
+    cache = cache_directory;
+end;
+
+end
@@ -0,0 +1,583 @@
+// trajectory_reader.h
+// Parser for trajectory files shared by the native trajectory readers of the
+// toolkit.
+//
+// The file is mapped into memory and parsed in a single pass into flat arrays
+// (a type code and a range of values for every frame), the MATLAB output is
+// allocated afterwards in one go. Numbers are parsed without the C library so
+// that the result does not depend on the locale and lines can be of any
+// length. The parser does not call the MEX API and can be used from worker
+// threads. Parsed trajectories can be cached in binary sidecar files.
+
+#ifndef TOOLKIT_TRAJECTORY_READER_H
+#define TOOLKIT_TRAJECTORY_READER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <locale.h>
+#include <vector>
+#include <string>
+#include <atomic>
+
+#if defined(_WIN32)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mex.h"
+#include "region_rle.h"
+
+// Region type codes, the same as the type codes of region_overlap.
+#define TRAJECTORY_SPECIAL 0
+#define TRAJECTORY_RECTANGLE 1
+#define TRAJECTORY_POLYGON 2
+#define TRAJECTORY_MASK 3
+
+typedef struct trajectory {
+    // Type code of every frame
+    std::vector<int> types;
+    // Values of the frame i are values[offsets[i]] to values[offsets[i + 1] - 1]
+    std::vector<size_t> offsets;
+    std::vector<double> values;
+    // Lines (counted from one) that could not be parsed
+    std::vector<int> invalid;
+} trajectory;
+
+// Read-only view of a whole file, mapped into memory where possible.
+class mapped_file {
+public:
+
+    mapped_file() : data(NULL), size(0), mapped(false) {}
+
+    ~mapped_file() { close(); }
+
+    bool open(const char* path) {
+
+        close();
+
+#if defined(_WIN32)
+        FILE* file = fopen(path, "rb");
+        if (!file) return false;
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        buffer.resize(length > 0 ? length : 0);
+        bool success = length >= 0 && (length == 0 || fread(&buffer[0], 1, length, file) == (size_t) length);
+        fclose(file);
+        if (!success) return false;
+        data = buffer.empty() ? NULL : &buffer[0];
+        size = buffer.size();
+        return true;
+#else
+        int descriptor = ::open(path, O_RDONLY);
+        if (descriptor < 0) return false;
+
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode)) {
+            ::close(descriptor);
+            return false;
+        }
+
+        size = (size_t) info.st_size;
+
+        if (size > 0) {
+            void* address = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (address == MAP_FAILED) {
+                ::close(descriptor);
+                size = 0;
+                return false;
+            }
+            data = (const char*) address;
+            mapped = true;
+        }
+
+        ::close(descriptor);
+        return true;
+#endif
+
+    }
+
+    void close() {
+
+#if !defined(_WIN32)
+        if (mapped) munmap((void*) data, size);
+#endif
+        buffer.clear();
+        data = NULL;
+        size = 0;
+        mapped = false;
+
+    }
+
+    const char* data;
+    size_t size;
+
+private:
+
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+
+    bool mapped;
+    std::vector<char> buffer;
+
+};
+
+// Parses a decimal number at the start of the text, returns a pointer after
+// the number or NULL if there is no number. Numbers with at most 19
+// significant digits and a small exponent are converted exactly, longer ones
+// are passed to strtod with the decimal point of the current locale.
+static inline const char* trajectory_parse_number(const char* text, const char* end, double& value) {
+
+    const char* p = text;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+')) negative = *(p++) == '-';
+
+    // Special values as printed by the C library
+    if (end - p >= 3 && (strncmp(p, "nan", 3) == 0 || strncmp(p, "NaN", 3) == 0 || strncmp(p, "NAN", 3) == 0)) {
+        value = NAN;
+        return p + 3;
+    }
+
+    if (end - p >= 3 && (strncmp(p, "inf", 3) == 0 || strncmp(p, "Inf", 3) == 0 || strncmp(p, "INF", 3) == 0)) {
+        value = negative ? -INFINITY : INFINITY;
+        return p + 3;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false, exact = true;
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        any = true;
+        if (mantissa == 0 && *p == '0') continue;
+        if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits++; }
+        else { exponent++; if (*p != '0') exact = false; }
+    }
+
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            any = true;
+            if (mantissa == 0 && *p == '0') { exponent--; continue; }
+            if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits++; exponent--; }
+            else if (*p != '0') exact = false;
+        }
+    }
+
+    if (!any) return NULL;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negative_exponent = false;
+        if (q < end && (*q == '-' || *q == '+')) negative_exponent = *(q++) == '-';
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            for (; q < end && *q >= '0' && *q <= '9'; q++)
+                if (e < 100000) e = e * 10 + (*q - '0');
+            exponent += negative_exponent ? -e : e;
+            p = q;
+        }
+    }
+
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    if (mantissa == 0) {
+        value = negative ? -0.0 : 0.0;
+    } else if (exact && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        // Both operands are exact, so a single operation is correctly rounded
+        value = exponent < 0 ? (double) mantissa / powers[-exponent] : (double) mantissa * powers[exponent];
+        if (negative) value = -value;
+    } else {
+        std::string copy(text, p);
+        const char* point = localeconv()->decimal_point;
+        size_t position = copy.find('.');
+        if (position != std::string::npos && point && strcmp(point, ".") != 0)
+            copy.replace(position, 1, point);
+        value = strtod(copy.c_str(), NULL);
+    }
+
+    return p;
+
+}
+
+// Parses a single line, returns false if the line is not a valid region.
+static inline bool trajectory_parse_line(const char* begin, const char* end, trajectory& result) {
+
+    while (begin < end && (*begin == ' ' || *begin == '\t')) begin++;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+
+    bool mask = begin < end && (*begin == 'm' || *begin == 'M');
+    if (mask) begin++;
+
+    size_t start = result.values.size();
+    const char* p = begin;
+
+    while (true) {
+
+        double value;
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        p = trajectory_parse_number(p, end, value);
+
+        if (!p) break;
+
+        result.values.push_back(value);
+
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+        if (p == end) break;
+
+        if (*p != ',') { p = NULL; break; }
+
+        p++;
+
+    }
+
+    size_t length = result.values.size() - start;
+    int type = -1;
+
+    if (p) {
+        if (mask) {
+            rle_mask parsed;
+            if (rle_mask_from_values(&result.values[start], (int) length, parsed)) type = TRAJECTORY_MASK;
+        } else if (length == 1) {
+            if (isfinite(result.values[start])) type = TRAJECTORY_SPECIAL;
+        } else if (length == 4) {
+            type = TRAJECTORY_RECTANGLE;
+        } else if (length >= 6 && length % 2 == 0) {
+            type = TRAJECTORY_POLYGON;
+        }
+    }
+
+    if (type < 0) {
+        result.values.resize(start);
+        return false;
+    }
+
+    // Regions are stored with single precision (and special codes as integers)
+    // by the region library, the values are rounded the same way.
+    if (type == TRAJECTORY_SPECIAL) {
+        result.values[start] = (double) (int) result.values[start];
+    } else if (type != TRAJECTORY_MASK) {
+        for (size_t i = start; i < result.values.size(); i++)
+            result.values[i] = (double) (float) result.values[i];
+    }
+
+    result.types.push_back(type);
+    result.offsets.push_back(result.values.size());
+
+    return true;
+
+}
+
+static inline void trajectory_parse(const char* data, size_t size, trajectory& result) {
+
+    result.types.clear();
+    result.offsets.assign(1, 0);
+    result.values.clear();
+    result.invalid.clear();
+
+    const char* end = data + size;
+    const char* line = data;
+    int number = 0;
+
+    while (line < end) {
+
+        const char* next = (const char*) memchr(line, '\n', end - line);
+        if (!next) next = end;
+
+        number++;
+
+        if (!trajectory_parse_line(line, next, result))
+            result.invalid.push_back(number);
+
+        line = next + 1;
+
+    }
+
+}
+
+// A parsed trajectory can be stored in a binary sidecar file next to the
+// text file (with the suffix .cache) that is used instead of parsing the text
+// as long as the size and the modification time of the text file match the
+// ones stored in its header. The sidecar contains the header, a type code and
+// a number of values for every frame, the values in single precision and the
+// numbers of lines that could not be parsed. The text file remains the
+// reference, the sidecar is written to a temporary file that is renamed, so a
+// reader never sees an incomplete sidecar.
+
+#define TRAJECTORY_CACHE_MAGIC 0x434a5254
+#define TRAJECTORY_CACHE_VERSION 1
+
+typedef struct trajectory_stamp {
+    unsigned long long size;
+    long long seconds;
+    long long nanoseconds;
+} trajectory_stamp;
+
+typedef struct trajectory_cache_header {
+    unsigned int magic;
+    unsigned int version;
+    trajectory_stamp stamp;
+    unsigned int frames;
+    unsigned int invalid;
+    unsigned long long values;
+} trajectory_cache_header;
+
+static inline bool trajectory_get_stamp(const char* path, trajectory_stamp& stamp) {
+
+    struct stat info;
+
+    if (stat(path, &info) != 0)
+        return false;
+
+    stamp.size = (unsigned long long) info.st_size;
+    stamp.seconds = (long long) info.st_mtime;
+#if defined(__APPLE__)
+    stamp.nanoseconds = (long long) info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    stamp.nanoseconds = 0;
+#else
+    stamp.nanoseconds = (long long) info.st_mtim.tv_nsec;
+#endif
+
+    return true;
+
+}
+
+static inline bool trajectory_load_cache(const std::string& filename, const trajectory_stamp& stamp, trajectory& result) {
+
+    mapped_file file;
+
+    if (!file.open(filename.c_str()) || file.size < sizeof(trajectory_cache_header))
+        return false;
+
+    trajectory_cache_header header;
+    memcpy(&header, file.data, sizeof(header));
+
+    if (header.magic != TRAJECTORY_CACHE_MAGIC || header.version != TRAJECTORY_CACHE_VERSION ||
+        header.stamp.size != stamp.size || header.stamp.seconds != stamp.seconds ||
+        header.stamp.nanoseconds != stamp.nanoseconds)
+        return false;
+
+    unsigned long long expected = sizeof(header) + (unsigned long long) header.frames * (sizeof(unsigned char) + sizeof(unsigned int)) +
+        header.values * sizeof(float) + (unsigned long long) header.invalid * sizeof(int);
+
+    if (expected != file.size)
+        return false;
+
+    const unsigned char* types = (const unsigned char*) file.data + sizeof(header);
+    const char* lengths = (const char*) (types + header.frames);
+    const char* values = lengths + header.frames * sizeof(unsigned int);
+    const char* invalid = values + header.values * sizeof(float);
+
+    result.types.resize(header.frames);
+    result.offsets.resize(header.frames + 1);
+    result.values.resize(header.values);
+    result.invalid.resize(header.invalid);
+
+    result.offsets[0] = 0;
+
+    for (unsigned int i = 0; i < header.frames; i++) {
+        unsigned int length;
+        memcpy(&length, lengths + i * sizeof(unsigned int), sizeof(length));
+        result.types[i] = types[i];
+        result.offsets[i + 1] = result.offsets[i] + length;
+    }
+
+    if (result.offsets[header.frames] != header.values)
+        return false;
+
+    for (unsigned long long i = 0; i < header.values; i++) {
+        float value;
+        memcpy(&value, values + i * sizeof(float), sizeof(value));
+        result.values[i] = value;
+    }
+
+    if (header.invalid > 0)
+        memcpy(&result.invalid[0], invalid, header.invalid * sizeof(int));
+
+    return true;
+
+}
+
+static inline void trajectory_save_cache(const std::string& filename, const trajectory_stamp& stamp, const trajectory& input) {
+
+    // Values of masks that do not fit into single precision are not cached
+    for (size_t i = 0; i < input.values.size(); i++)
+        if ((double) (float) input.values[i] != input.values[i] && !isnan(input.values[i])) return;
+
+    static std::atomic<unsigned int> counter(0);
+
+    char suffix[64];
+    sprintf(suffix, ".%u.%u.tmp", (unsigned int) getpid(), counter++);
+    std::string temporary = filename + suffix;
+
+    FILE* file = fopen(temporary.c_str(), "wb");
+
+    if (!file) return;
+
+    trajectory_cache_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TRAJECTORY_CACHE_MAGIC;
+    header.version = TRAJECTORY_CACHE_VERSION;
+    header.stamp = stamp;
+    header.frames = (unsigned int) input.types.size();
+    header.invalid = (unsigned int) input.invalid.size();
+    header.values = input.values.size();
+
+    std::vector<unsigned char> types(input.types.begin(), input.types.end());
+    std::vector<unsigned int> lengths(header.frames);
+    std::vector<float> values(input.values.begin(), input.values.end());
+
+    for (unsigned int i = 0; i < header.frames; i++)
+        lengths[i] = (unsigned int) (input.offsets[i + 1] - input.offsets[i]);
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(types.data(), 1, types.size(), file) == types.size() &&
+        fwrite(lengths.data(), sizeof(unsigned int), lengths.size(), file) == lengths.size() &&
+        fwrite(values.data(), sizeof(float), values.size(), file) == values.size() &&
+        fwrite(input.invalid.data(), sizeof(int), input.invalid.size(), file) == input.invalid.size();
+
+    success = fclose(file) == 0 && success;
+
+#if defined(_WIN32)
+    if (success) remove(filename.c_str());
+#endif
+
+    if (!success || rename(temporary.c_str(), filename.c_str()) != 0)
+        remove(temporary.c_str());
+
+}
+
+// Returns the name of the binary sidecar of a trajectory file. Without a
+// cache directory the sidecar is stored next to the file, otherwise in the
+// directory with the name of the file and a hash of its full path.
+static inline std::string trajectory_sidecar(const char* path, const std::string& directory) {
+
+    if (directory.empty())
+        return std::string(path) + ".cache";
+
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (const char* c = path; *c; c++)
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+
+    const char* name = path;
+
+    for (const char* c = path; *c; c++)
+        if (*c == '/' || *c == '\\') name = c + 1;
+
+    char suffix[32];
+    sprintf(suffix, ".%016llx.cache", hash);
+
+    return directory + "/" + name + suffix;
+
+}
+
+// Reads a trajectory file, returns false if the file can not be opened. If
+// the cache is enabled, the binary sidecar is used when it is valid and
+// written otherwise.
+static inline bool trajectory_read(const char* path, trajectory& result, bool cache = false,
+    const std::string& directory = std::string()) {
+
+    trajectory_stamp stamp;
+    std::string sidecar = trajectory_sidecar(path, directory);
+
+    // The stamp is taken before the text is read, a later change invalidates the sidecar
+    cache = cache && trajectory_get_stamp(path, stamp);
+
+    if (cache && trajectory_load_cache(sidecar, stamp, result))
+        return true;
+
+    mapped_file file;
+
+    if (!file.open(path))
+        return false;
+
+    trajectory_parse(file.data, file.size, result);
+
+    if (cache)
+        trajectory_save_cache(sidecar, stamp, result);
+
+    return true;
+
+}
+
+// Converts a trajectory to a column cell array of region vectors.
+static inline mxArray* trajectory_to_cell(const trajectory& input) {
+
+    int count = (int) input.types.size();
+    mxArray* result = mxCreateCellMatrix(count, 1);
+
+    for (int i = 0; i < count; i++) {
+
+        const double* values = &input.values[0] + input.offsets[i];
+        size_t length = input.offsets[i + 1] - input.offsets[i];
+        mxArray* val;
+
+        if (input.types[i] == TRAJECTORY_MASK) {
+            val = mxCreateNumericMatrix(1, length, mxINT32_CLASS, mxREAL);
+            int* p = (int*) mxGetData(val);
+            for (size_t j = 0; j < length; j++) p[j] = (int) values[j];
+        } else {
+            val = mxCreateDoubleMatrix(1, length, mxREAL);
+            memcpy(mxGetPr(val), values, length * sizeof(double));
+        }
+
+        mxSetCell(result, i, val);
+
+    }
+
+    return result;
+
+}
+
+// Converts a trajectory to a matrix with one region per row padded with NaN
+// values (special frames have their code in the first column), a column of
+// type codes and a column of special codes (NaN for other frames).
+static inline void trajectory_to_matrix(const trajectory& input, mxArray** regions, mxArray** types, mxArray** codes) {
+
+    int count = (int) input.types.size();
+    size_t width = 0;
+
+    for (int i = 0; i < count; i++)
+        width = MAX(width, input.offsets[i + 1] - input.offsets[i]);
+
+    *regions = mxCreateDoubleMatrix(count, width, mxREAL);
+    double* r = mxGetPr(*regions);
+
+    for (size_t i = 0; i < (size_t) count * width; i++)
+        r[i] = NAN;
+
+    for (int i = 0; i < count; i++)
+        for (size_t j = input.offsets[i]; j < input.offsets[i + 1]; j++)
+            r[i + (j - input.offsets[i]) * count] = input.values[j];
+
+    if (types) {
+        *types = mxCreateDoubleMatrix(count, 1, mxREAL);
+        double* t = mxGetPr(*types);
+        for (int i = 0; i < count; i++)
+            t[i] = input.types[i];
+    }
+
+    if (codes) {
+        *codes = mxCreateDoubleMatrix(count, 1, mxREAL);
+        double* c = mxGetPr(*codes);
+        for (int i = 0; i < count; i++)
+            c[i] = input.types[i] == TRAJECTORY_SPECIAL ? input.values[input.offsets[i]] : NAN;
+    }
+
+}
+
+#endif
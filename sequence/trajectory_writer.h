@@ -0,0 +1,146 @@
+// trajectory_writer.h
+// Formatting of regions for trajectory files.
+//
+// Region values are stored with single precision by the region library and
+// by the trajectory readers, so every number is written with the fewest
+// decimals that read back as the same single precision value. The digits are
+// produced with integer arithmetic, printf is only used for values that do
+// not fit into the fixed point form.
+
+#ifndef TOOLKIT_TRAJECTORY_WRITER_H
+#define TOOLKIT_TRAJECTORY_WRITER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+#include "mex.h"
+#include "region_rle.h"
+
+// Writes the decimal digits of an integer to the buffer, returns the length.
+static inline int trajectory_format_integer(long long value, char* buffer) {
+
+    char digits[24];
+    int count = 0, length = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long) value : (unsigned long long) value;
+
+    do {
+        digits[count++] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    if (value < 0) buffer[length++] = '-';
+
+    while (count > 0) buffer[length++] = digits[--count];
+
+    buffer[length] = '\0';
+
+    return length;
+
+}
+
+// Writes the shortest fixed point form of a number that is parsed back to
+// the same single precision value, the buffer must hold at least 32 bytes.
+// Returns the length of the text.
+static inline int trajectory_format_number(double input, char* buffer) {
+
+    if (isnan(input)) { strcpy(buffer, "nan"); return 3; }
+    if (isinf(input)) { strcpy(buffer, input < 0 ? "-inf" : "inf"); return input < 0 ? 4 : 3; }
+
+    float target = (float) input;
+    double value = target;
+
+    if (fabs(value) < 1e15 && value == floor(value))
+        return trajectory_format_integer((long long) value, buffer);
+
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    for (int decimals = 1; decimals <= 22 && fabs(value) * powers[decimals] < 9007199254740992.0; decimals++) {
+
+        long long mantissa = llround(value * powers[decimals]);
+
+        // The division is correctly rounded as in the parser of the readers
+        if ((float) ((double) mantissa / powers[decimals]) != target)
+            continue;
+
+        char digits[32];
+        int count = trajectory_format_integer(mantissa < 0 ? -mantissa : mantissa, digits);
+        int length = 0;
+
+        if (mantissa < 0) buffer[length++] = '-';
+
+        if (count <= decimals) {
+            buffer[length++] = '0';
+            buffer[length++] = '.';
+            for (int i = count; i < decimals; i++) buffer[length++] = '0';
+            memcpy(buffer + length, digits, count);
+            length += count;
+        } else {
+            memcpy(buffer + length, digits, count - decimals);
+            length += count - decimals;
+            buffer[length++] = '.';
+            memcpy(buffer + length, digits + count - decimals, decimals);
+            length += decimals;
+        }
+
+        buffer[length] = '\0';
+        return length;
+
+    }
+
+    return sprintf(buffer, "%.9g", value);
+
+}
+
+// Formats a region (a special code, a rectangle, a polygon or an int32 mask)
+// as a line of a trajectory file without the line break. Returns false if
+// the array is not a valid region.
+static inline bool trajectory_format_region(const mxArray* region, std::string& line) {
+
+    line.clear();
+
+    if (!region || mxIsEmpty(region) || mxGetNumberOfDimensions(region) > 2 || MIN(mxGetM(region), mxGetN(region)) != 1)
+        return false;
+
+    if (mxIsInt32(region)) {
+
+        rle_mask mask;
+
+        if (!rle_mask_from_array(region, mask))
+            return false;
+
+        line = rle_mask_string(mask);
+        return true;
+
+    }
+
+    if (!mxIsDouble(region))
+        return false;
+
+    const double* values = mxGetPr(region);
+    int length = (int) mxGetNumberOfElements(region);
+    char buffer[32];
+
+    if (length == 1) {
+        // Special codes are integers
+        if (!isfinite(values[0])) return false;
+        trajectory_format_integer((long long) (int) values[0], buffer);
+        line = buffer;
+        return true;
+    }
+
+    if (length != 4 && (length < 6 || length % 2 != 0))
+        return false;
+
+    for (int i = 0; i < length; i++) {
+        if (i) line += ',';
+        line.append(buffer, trajectory_format_number(values[i], buffer));
+    }
+
+    return true;
+
+}
+
+#endif
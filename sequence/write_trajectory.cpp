@@ -1,8 +1,24 @@
 
 #include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "mex.h"
-#include "region.h"
+#include "trajectory_reader.h"
+#include "trajectory_writer.h"
+
+#if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER)
+#define strcmpi _strcmpi
+#else
+#define strcmpi strcasecmp
+#endif
 
 char* getString(const mxArray *arg) {
 
@@ -12,107 +28,315 @@ char* getString(const mxArray *arg) {
     int l = mxGetN(arg);
 
     char* str = (char *) malloc(sizeof(char) * (l + 1));
-    
+
     mxGetString(arg, str, (l + 1));
-    
+
     return str;
 }
 
-void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+int getSingleInteger(const mxArray *arg) {
 
-    region_container** regions = NULL;
+	if (mxGetM(arg) != 1 || mxGetN(arg) != 1)
+		mexErrMsgTxt("Parameter must be a single value");
 
-	if( nrhs != 2 ) mexErrMsgTxt("Exactly one string input argument and one cell array argument required.");
-	if( nlhs != 0 ) mexErrMsgTxt("No output arguments required.");
+    if (mxIsInt32(arg))
+        return ((int*)mxGetPr(arg))[0];
 
-	char* path = getString(prhs[0]);
+    if (mxIsDouble(arg))
+        return (int) ((double*)mxGetPr(arg))[0];
 
-	if (!mxIsCell(prhs[1]))
-		mexErrMsgTxt("Second argument must be a cell array");
+    return 0;
+}
 
-	int length = MAX(mxGetM(prhs[1]), mxGetN(prhs[1]));
+// Formats a region of a trajectory, invalid regions are replaced by the
+// special code -1 with a warning.
+void format_region(const mxArray* region, int position, std::string& line) {
 
-	if ( MIN(mxGetM(prhs[1]), mxGetN(prhs[1])) != 1 )
-		mexErrMsgTxt("Cell array must be a vector");
+    if (trajectory_format_region(region, line))
+        return;
 
-    regions = (region_container**) malloc(sizeof(region_container*) * length);
+    char message[128];
+    sprintf(message, "Not a valid region at position %d, skipping", position);
+    mexWarnMsgTxt(message);
 
-	for (int i = 0; i < length; i++) {
+    line = "-1";
+
+}
+
+// A trajectory file that is written frame by frame. Frames are appended to a
+// partial file (the name of the file with the suffix .part) that is flushed
+// every few frames and renamed to the final name when the writer is closed,
+// so the final file is either complete or does not exist. If the writing is
+// interrupted, the partial file is kept and the frames in it are returned
+// when a writer for the same file is opened again.
+
+typedef struct trajectory_stream {
+    std::string filename;
+    std::string partial;
+    FILE* file;
+    int frames;
+    int interval;
+    int pending;
+} trajectory_stream;
+
+static std::map<int, trajectory_stream*> streams;
+static int stream_counter = 0;
+
+static void close_stream(trajectory_stream* stream) {
+
+    if (stream->file) {
+        fflush(stream->file);
+        fclose(stream->file);
+        stream->file = NULL;
+    }
+
+}
 
-		mxArray* val = mxGetCell (prhs[1], i);
+static void release_resources() {
 
-		region_container* region = NULL;
+    // Partial files of unfinished trajectories are kept
+    for (std::map<int, trajectory_stream*>::iterator it = streams.begin(); it != streams.end(); it++) {
+        close_stream(it->second);
+        delete it->second;
+    }
 
-        if (val) {
+    streams.clear();
 
-		    double *d = (double*) mxGetPr(val);
-		    int l = MAX(mxGetM(val), mxGetN(val));
+}
+
+trajectory_stream* get_stream(const mxArray* arg) {
+
+    std::map<int, trajectory_stream*>::iterator it = streams.find(getSingleInteger(arg));
 
-		    if (!mxIsEmpty(val) && MIN(mxGetM(val), mxGetN(val)) == 1) { 
+    if (it == streams.end())
+        mexErrMsgTxt("Unknown trajectory writer");
+
+    return it->second;
+
+}
 
-			    if (l == 1) {
+// Keeps the given number of complete lines in the partial file (all if the
+// count is negative) and opens it for appending. The kept content is stored
+// in the last argument, returns false if the file cannot be written.
+bool reopen_stream(trajectory_stream* stream, int count, std::string& content) {
 
-				    region = region_create_special(d[0]);
+    close_stream(stream);
 
-			    } else if (l == 4) {
+    content.clear();
 
-				    region = region_create_rectangle(d[0], d[1], d[2], d[3]);
+    {
+        mapped_file file;
+        if (file.open(stream->partial.c_str()) && file.size > 0)
+            content.assign(file.data, file.size);
+    }
 
-			    } else if (l > 5 && l % 2 == 0) {
+    size_t end = 0;
+    int lines = 0;
 
-				    region = region_create_polygon(l / 2);
+    while (count < 0 || lines < count) {
+        size_t next = content.find('\n', end);
+        if (next == std::string::npos) break;
+        end = next + 1;
+        lines++;
+    }
 
-				    for (int j = 0; j < l / 2; j++) {
-					    region->data.polygon.x[j] = d[j * 2];
-					    region->data.polygon.y[j] = d[j * 2 + 1];
-				    }
-			    }
+    // An incomplete last line is dropped together with the removed lines
+    content.resize(end);
 
-		    }
+    FILE* file = fopen(stream->partial.c_str(), "wb");
 
+    if (!file) return false;
+
+    bool success = fwrite(content.data(), 1, content.size(), file) == content.size();
+
+    if (fclose(file) != 0 || !success) return false;
+
+    stream->file = fopen(stream->partial.c_str(), "ab");
+
+    if (!stream->file) return false;
+
+    stream->frames = lines;
+    stream->pending = 0;
+
+    return true;
+
+}
+
+void stream_command(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+    char* command = getString(prhs[0]);
+
+    if (strcmpi(command, "open") == 0) {
+
+        free(command);
+
+        if( nrhs < 2 ) mexErrMsgTxt("File argument required (plus optional flush interval).");
+        if( nlhs > 2 ) mexErrMsgTxt("At most two output arguments required.");
+
+        char* path = getString(prhs[1]);
+
+        trajectory_stream* stream = new trajectory_stream();
+        stream->filename = path;
+        stream->partial = stream->filename + ".part";
+        stream->file = NULL;
+        stream->interval = nrhs > 2 ? MAX(1, getSingleInteger(prhs[2])) : 1;
+
+        free(path);
+
+        std::string content;
+
+        // The writer is not registered yet, it has to be released before the error
+        if (!reopen_stream(stream, -1, content)) {
+            delete stream;
+            mexErrMsgTxt("Unable to open file for writing.");
         }
 
-		if (region) {
-			regions[i] = region;
-		} else {
-			char message[128];
-			sprintf(message, "Not a valid region at position %d, skipping", i+1);
-			mexWarnMsgTxt(message);
-            regions[i] = region_create_special(-1);
-		}
+        streams[++stream_counter] = stream;
 
-	}
+        plhs[0] = mxCreateDoubleScalar(stream_counter);
 
-    FILE* fp = fopen(path, "w");
+        if (nlhs > 1) {
+            trajectory existing;
+            trajectory_parse(content.data(), content.size(), existing);
+            plhs[1] = trajectory_to_cell(existing);
+        }
 
-	if (fp != NULL) {
+    } else if (strcmpi(command, "append") == 0) {
 
-    	for (int i = 0; i < length; i++) {
+        free(command);
 
-			region_container* region = regions[i];
+        if( nrhs != 3 ) mexErrMsgTxt("Writer and region arguments required.");
 
-			char* tmp = region_string(region);
+        trajectory_stream* stream = get_stream(prhs[1]);
+        std::string line, lines;
 
-			if (tmp) {
-				fputs(tmp, fp);
-                fputc('\n', fp);
-				free(tmp);
-			}
-			
-			region_release(&region);
+        if (!stream->file) mexErrMsgTxt("Unable to write to file.");
 
-		}
+        if (mxIsCell(prhs[2])) {
+            int count = (int) mxGetNumberOfElements(prhs[2]);
+            for (int i = 0; i < count; i++) {
+                format_region(mxGetCell(prhs[2], i), stream->frames + i + 1, line);
+                lines += line;
+                lines += '\n';
+            }
+            stream->frames += count;
+            stream->pending += count;
+        } else {
+            format_region(prhs[2], stream->frames + 1, line);
+            lines += line;
+            lines += '\n';
+            stream->frames++;
+            stream->pending++;
+        }
+
+        if (fwrite(lines.data(), 1, lines.size(), stream->file) != lines.size())
+            mexErrMsgTxt("Unable to write to file.");
 
-	} else {
+        if (stream->pending >= stream->interval) {
+            fflush(stream->file);
+            stream->pending = 0;
+        }
 
+        if (nlhs > 0) plhs[0] = mxCreateDoubleScalar(stream->frames);
+
+    } else if (strcmpi(command, "truncate") == 0) {
+
+        free(command);
+
+        if( nrhs != 3 ) mexErrMsgTxt("Writer and frame count arguments required.");
+
+        trajectory_stream* stream = get_stream(prhs[1]);
+
+        std::string content;
+
+        if (!reopen_stream(stream, MAX(0, getSingleInteger(prhs[2])), content))
+            mexErrMsgTxt("Unable to open file for writing.");
+
+    } else if (strcmpi(command, "close") == 0 || strcmpi(command, "abort") == 0) {
+
+        bool finalize = strcmpi(command, "close") == 0;
+
+        free(command);
+
+        if( nrhs != 2 ) mexErrMsgTxt("Writer argument required.");
+
+        trajectory_stream* stream = get_stream(prhs[1]);
+        streams.erase(getSingleInteger(prhs[1]));
+
+        bool success = stream->file != NULL;
+
+        if (finalize && success) {
+            success = fflush(stream->file) == 0;
+#if !defined(_WIN32)
+            // The content has to reach the disk before the file gets its final name
+            success = success && fsync(fileno(stream->file)) == 0;
+#endif
+        }
+
+        if (stream->file)
+            success = fclose(stream->file) == 0 && success;
+        stream->file = NULL;
+
+        if (finalize && success) {
+#if defined(_WIN32)
+            remove(stream->filename.c_str());
+#endif
+            success = rename(stream->partial.c_str(), stream->filename.c_str()) == 0;
+        }
+
+        delete stream;
+
+        if (!success)
+            mexErrMsgTxt("Unable to finalize trajectory file.");
+
+    } else {
+
+        free(command);
+        mexErrMsgTxt("Unknown command");
+
+    }
+
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+    mexAtExit(release_resources);
+
+    if (nrhs > 0 && mxIsChar(prhs[0]) && (nrhs < 2 || !mxIsCell(prhs[1]))) {
+        stream_command(nlhs, plhs, nrhs, prhs);
+        return;
+    }
+
+	if( nrhs != 2 ) mexErrMsgTxt("Exactly one string input argument and one cell array argument required.");
+	if( nlhs != 0 ) mexErrMsgTxt("No output arguments required.");
+
+	if (!mxIsCell(prhs[1]))
+		mexErrMsgTxt("Second argument must be a cell array");
+
+	int length = MAX(mxGetM(prhs[1]), mxGetN(prhs[1]));
+
+	if ( MIN(mxGetM(prhs[1]), mxGetN(prhs[1])) != 1 && length > 0 )
+		mexErrMsgTxt("Cell array must be a vector");
+
+	char* path = getString(prhs[0]);
+
+	std::string line, content;
+
+	for (int i = 0; i < length; i++) {
+		format_region(mxGetCell(prhs[1], i), i + 1, line);
+		content += line;
+		content += '\n';
+	}
+
+    FILE* fp = fopen(path, "w");
+
+	if (fp == NULL) {
 		free(path);
 		mexErrMsgTxt("Unable to open file for writing.");
 	}
 
-    if (regions)
-        free(regions);
+	fwrite(content.data(), 1, content.size(), fp);
 
 	fclose(fp);
 	free(path);
 }
-
@@ -48,9 +48,7 @@ experiments = {baseline, region_noise, grayscale};
 
 end
 
-function [transform] = noisy_transform(sequence, index, context)
-
-    bounds = region_convert(sequence_get_region(sequence, index), 'rectangle');
+function [transform] = noisy_transform(sequence, index, context, bounds)
 
     scale = 0.9 + rand(1, 2) * 0.2;
     move = bounds(3:4) .* (0.1 - rand(1, 2) * 0.2);
@@ -2,7 +2,15 @@ function filename = benchmark_hardware(varargin)
 % benchmark_hardware Perform a simple hardware benchmark
 %
 % Performs a simple benchmark of the computer that can be later used to normalize
-% the speed estimate between results obtained on different hardware.
+% the speed estimate between results obtained on different hardware. Besides the
+% filters the profile contains the time and the rate of native matrix multiplication,
+% FFT, memory bandwidth and vectorized correlation kernels (GFLOPS or GB/s) and
+% the scaling of the matrix multiplication with the number of threads. The memory
+% hierarchy is described by the latency and bandwidth for working sets from 4 KB
+% to 1 GB and by the plateaus detected in them (caches and main memory). Every kernel
+% is warmed up and repeated, the profile contains the median time and its median
+% absolute deviation together with the frequency governor and the processor affinity
+% under which the benchmark was performed.
 %
 % Output:
 % - filename: Path to the local performance profile.
@@ -20,10 +28,19 @@ print_indent(1);
 
 performance = struct('reading', NaN, ...
     'convolution_native', NaN, 'convolution_matlab', NaN, ...
-    'nonlinear_native', NaN);
+    'nonlinear_native', NaN, 'sgemm_native', NaN, 'sgemm_rate', NaN, ...
+    'fft_native', NaN, 'fft_rate', NaN, 'bandwidth_native', NaN, 'bandwidth_rate', NaN, ...
+    'correlation_native', NaN, 'correlation_rate', NaN, ...
+    'scaling_threads', NaN, 'scaling_rate', NaN, 'scaling_efficiency', NaN, ...
+    'cache_sizes', NaN, 'cache_latency', NaN, 'cache_bandwidth', NaN, ...
+    'dram_latency', NaN, 'dram_bandwidth', NaN);
 
 repetitions = 20;
 
+print_debug('Reading system information');
+
+performance.system = benchmark_native('system');
+
 temporary_dir = tempdir;
 
 image_file = fullfile(temporary_dir, 'image.jpg');
@@ -33,13 +50,7 @@ print_debug('Performing IO image reading benchmark');
 I = rand(600, 600);
 imwrite(I, image_file);
 
-tic;
-
-for i = 1:repetitions
-    imread(image_file);
-end;
-
-performance.reading = toc / repetitions;
+[performance.reading, performance.reading_mad] = measure_median(@() imread(image_file), repetitions);
 
 delete(image_file);
 
@@ -48,38 +59,62 @@ print_debug('Performing native convolution filter benchmark');
 I = rand(600, 600);
 K = rand(30, 30);
 
-tic;
+[performance.convolution_native, performance.convolution_native_mad] = ...
+    measure_median(@() benchmark_native('convolution', I, K), repetitions);
 
-for i = 1:repetitions
-    benchmark_native('convolution', I, K);
-end;
+print_debug('Performing Matlab convolution filter benchmark');
 
-performance.convolution_native = toc / repetitions;
+[performance.convolution_matlab, performance.convolution_matlab_mad] = ...
+    measure_median(@() conv2(I, K), repetitions);
 
-print_debug('Performing Matlab convolution filter benchmark');
+print_debug('Performing native nonlinear max filter benchmark');
 
-I = rand(600, 600);
-K = rand(30, 30);
+[performance.nonlinear_native, performance.nonlinear_native_mad] = ...
+    measure_median(@() benchmark_native('maxfilter', I, 20, 20), repetitions);
 
-tic;
+print_debug('Performing native matrix multiplication benchmark');
 
-for i = 1:repetitions
-    conv2(I, K);
-end;
+[performance.sgemm_native, performance.sgemm_rate, statistics] = benchmark_native('sgemm', 512, 1);
+performance = store_statistics(performance, 'sgemm', statistics);
 
-performance.convolution_matlab = toc / repetitions;
+print_debug('Performing native FFT benchmark');
 
-print_debug('Performing native nonlinear max filter benchmark');
+[performance.fft_native, performance.fft_rate, statistics] = benchmark_native('fft', 65536, 10);
+performance = store_statistics(performance, 'fft', statistics);
 
-I = rand(600, 600);
+print_debug('Performing native memory bandwidth benchmark');
 
-tic;
+[performance.bandwidth_native, performance.bandwidth_rate, statistics] = benchmark_native('bandwidth', 128, 1);
+performance = store_statistics(performance, 'bandwidth', statistics);
 
-for i = 1:repetitions
-    benchmark_native('maxfilter', I, 20, 20);
-end;
+print_debug('Performing native correlation benchmark');
+
+[performance.correlation_native, performance.correlation_rate, statistics] = benchmark_native('correlation', 600, 15, 1);
+performance = store_statistics(performance, 'correlation', statistics);
+
+print_debug('Performing native multi-core scaling benchmark');
 
-performance.nonlinear_native = toc / repetitions;
+[~, rates, threads] = benchmark_native('scaling', [], true, 'sgemm', 256, 1);
+
+performance.scaling_threads = threads;
+performance.scaling_rate = rates;
+performance.scaling_efficiency = rates ./ (threads * rates(1));
+
+print_debug('Performing native memory hierarchy benchmark');
+
+[sizes, latency, bandwidth, levels] = benchmark_native('latency', 4, 1024 * 1024);
+
+performance.memory_sizes = sizes;
+performance.memory_latency = latency;
+performance.memory_bandwidth = bandwidth;
+
+if ~isempty(levels)
+    performance.cache_sizes = levels(1:end-1, 1)';
+    performance.cache_latency = levels(1:end-1, 2)';
+    performance.cache_bandwidth = levels(1:end-1, 3)';
+    performance.dram_latency = levels(end, 2);
+    performance.dram_bandwidth = levels(end, 3);
+end;
 
 if ~is_octave()
 	print_debug('Performing Matlab startup time benchmark');
@@ -149,3 +184,32 @@ performance.platform_endian = platform_endian;
 writestruct(filename, performance);
 
 print_indent(-1);
+
+end
+
+function [time, deviation] = measure_median(operation, repetitions)
+% Times individual calls after a warmup call, returns the median time and the
+% median absolute deviation.
+
+operation();
+
+times = zeros(repetitions, 1);
+
+for i = 1:repetitions
+    start = tic;
+    operation();
+    times(i) = toc(start);
+end;
+
+time = median(times);
+deviation = median(abs(times - time));
+
+end
+
+function performance = store_statistics(performance, name, statistics)
+
+performance.([name, '_mad']) = statistics.mad;
+performance.([name, '_samples']) = statistics.samples;
+performance.([name, '_interval']) = statistics.interval;
+
+end
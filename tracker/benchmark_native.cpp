@@ -3,7 +3,29 @@
 
 // Normal C / C++ includes
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <new>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 // Including Matlab headers
 #include "mex.h"
@@ -101,6 +123,600 @@ void maxfilter2D(double* in, double* out, int dataSizeX, int dataSizeY, int kern
 
 }
 
+// The following benchmarks allocate their own data and measure themselves, each
+// run performs a fixed amount of work (floating point operations or bytes) so
+// that the speed can be reported as a rate.
+
+class Benchmark {
+public:
+    virtual ~Benchmark() {}
+
+    virtual void run() = 0;
+
+    // Amount of work done by a single run (operations or bytes).
+    virtual double work() const = 0;
+
+    // Value of the result that the compiler cannot discard.
+    virtual float check() const = 0;
+};
+
+void fillRandom(std::vector<float>& data, unsigned int seed) {
+
+    for (size_t i = 0; i < data.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        data[i] = (float) (seed >> 8) / (float) (1 << 24) - 0.5f;
+    }
+
+}
+
+// Single precision matrix multiplication C = A * B of square matrices, the
+// matrices are processed in blocks that fit into the cache and the innermost
+// loop runs over consecutive elements so that it can be vectorized.
+class SgemmBenchmark : public Benchmark {
+public:
+    SgemmBenchmark(int size) : size(size), a(size * size), b(size * size), c(size * size) {
+        fillRandom(a, 1);
+        fillRandom(b, 2);
+    }
+
+    virtual void run() {
+
+        const int block = 64;
+
+        memset(&c[0], 0, sizeof(float) * c.size());
+
+        for (int ii = 0; ii < size; ii += block) {
+            int iMax = ii + block < size ? ii + block : size;
+            for (int kk = 0; kk < size; kk += block) {
+                int kMax = kk + block < size ? kk + block : size;
+                for (int jj = 0; jj < size; jj += block) {
+                    int jMax = jj + block < size ? jj + block : size;
+                    for (int i = ii; i < iMax; i++) {
+                        float* __restrict cRow = &c[i * size];
+                        for (int k = kk; k < kMax; k++) {
+                            const float* __restrict bRow = &b[k * size];
+                            float aValue = a[i * size + k];
+                            for (int j = jj; j < jMax; j++)
+                                cRow[j] += aValue * bRow[j];
+                        }
+                    }
+                }
+            }
+        }
+
+    }
+
+    virtual double work() const { return 2.0 * size * size * size; }
+
+    virtual float check() const { return c[c.size() / 2]; }
+
+private:
+    int size;
+    std::vector<float> a, b, c;
+};
+
+// Iterative radix-2 complex FFT of a single precision signal, the length has
+// to be a power of two.
+class FFTBenchmark : public Benchmark {
+public:
+    FFTBenchmark(int length) : length(length), sourceReal(length), sourceImaginary(length),
+        real(length), imaginary(length), twiddleReal(length / 2), twiddleImaginary(length / 2), reversed(length) {
+
+        fillRandom(sourceReal, 3);
+        fillRandom(sourceImaginary, 4);
+
+        int bits = 0;
+        while ((1 << bits) < length) bits++;
+
+        for (int i = 0; i < length; i++) {
+            int r = 0;
+            for (int j = 0; j < bits; j++)
+                if (i & (1 << j)) r |= 1 << (bits - 1 - j);
+            reversed[i] = r;
+        }
+
+        for (int i = 0; i < length / 2; i++) {
+            twiddleReal[i] = (float) cos(-2 * M_PI * i / length);
+            twiddleImaginary[i] = (float) sin(-2 * M_PI * i / length);
+        }
+
+    }
+
+    virtual void run() {
+
+        for (int i = 0; i < length; i++) {
+            real[reversed[i]] = sourceReal[i];
+            imaginary[reversed[i]] = sourceImaginary[i];
+        }
+
+        for (int span = 2; span <= length; span <<= 1) {
+            int half = span >> 1;
+            int step = length / span;
+            for (int start = 0; start < length; start += span) {
+                for (int k = 0; k < half; k++) {
+                    float wr = twiddleReal[k * step];
+                    float wi = twiddleImaginary[k * step];
+                    int p = start + k;
+                    int q = p + half;
+                    float tr = wr * real[q] - wi * imaginary[q];
+                    float ti = wr * imaginary[q] + wi * real[q];
+                    real[q] = real[p] - tr;
+                    imaginary[q] = imaginary[p] - ti;
+                    real[p] += tr;
+                    imaginary[p] += ti;
+                }
+            }
+        }
+
+    }
+
+    virtual double work() const {
+        double bits = log((double) length) / log(2.0);
+        return 5.0 * length * bits;
+    }
+
+    virtual float check() const { return real[length / 2]; }
+
+private:
+    int length;
+    std::vector<float> sourceReal, sourceImaginary, real, imaginary, twiddleReal, twiddleImaginary;
+    std::vector<int> reversed;
+};
+
+// Streaming triad a = b + s * c over arrays that are much larger than the
+// caches, the work is the number of bytes read and written.
+class BandwidthBenchmark : public Benchmark {
+public:
+    BandwidthBenchmark(int megabytes) : count((size_t) megabytes * 1024 * 1024 / sizeof(double)),
+        a(count, 0), b(count, 1), c(count, 2) {}
+
+    virtual void run() {
+
+        double* __restrict pa = &a[0];
+        const double* __restrict pb = &b[0];
+        const double* __restrict pc = &c[0];
+        const double scalar = 3;
+
+        for (size_t i = 0; i < count; i++)
+            pa[i] = pb[i] + scalar * pc[i];
+
+    }
+
+    virtual double work() const { return 3.0 * sizeof(double) * count; }
+
+    virtual float check() const { return (float) a[count / 2]; }
+
+private:
+    size_t count;
+    std::vector<double> a, b, c;
+};
+
+// Single precision correlation of a square image with a square kernel (valid
+// part only). Every kernel value is applied to a whole row at once, so the
+// innermost loop is a multiply-add over consecutive elements that the compiler
+// turns into vector instructions.
+class CorrelationBenchmark : public Benchmark {
+public:
+    CorrelationBenchmark(int size, int kernelSize) : size(size), kernelSize(kernelSize),
+        outputSize(size - kernelSize + 1), image(size * size), kernel(kernelSize * kernelSize),
+        output(outputSize * outputSize) {
+        fillRandom(image, 5);
+        fillRandom(kernel, 6);
+    }
+
+    virtual void run() {
+
+        memset(&output[0], 0, sizeof(float) * output.size());
+
+        for (int y = 0; y < outputSize; y++) {
+            float* __restrict row = &output[y * outputSize];
+            for (int ky = 0; ky < kernelSize; ky++) {
+                for (int kx = 0; kx < kernelSize; kx++) {
+                    const float* __restrict source = &image[(y + ky) * size + kx];
+                    float weight = kernel[ky * kernelSize + kx];
+                    for (int x = 0; x < outputSize; x++)
+                        row[x] += weight * source[x];
+                }
+            }
+        }
+
+    }
+
+    virtual double work() const { return 2.0 * outputSize * outputSize * kernelSize * kernelSize; }
+
+    virtual float check() const { return output[output.size() / 2]; }
+
+private:
+    int size, kernelSize, outputSize;
+    std::vector<float> image, kernel, output;
+};
+
+volatile float benchmarkSink = 0;
+
+// Runs a benchmark the given number of times and returns the average duration
+// of a run in seconds.
+double measure(Benchmark* benchmark, int repetitions) {
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < repetitions; i++) {
+        benchmark->run();
+        benchmarkSink = benchmark->check();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / repetitions;
+}
+
+struct Statistics {
+    double median;
+    double mad;
+    double interval;
+    int samples;
+    int warmup;
+};
+
+#define HARNESS_MINIMUM_SAMPLES 10
+#define HARNESS_MAXIMUM_SAMPLES 1000
+#define HARNESS_MAXIMUM_WARMUP 20
+#define HARNESS_PRECISION 0.02
+#define HARNESS_SETTLED 0.05
+#define HARNESS_BUDGET 5.0
+
+#define MEMORY_LINE 64
+#define MEMORY_STEPS (1 << 16)
+#define MEMORY_READ (16 << 20)
+#define MEMORY_BUDGET 0.5
+#define MEMORY_PLATEAU 1.5
+#define MEMORY_STEP 1.25
+
+double median(std::vector<double> values) {
+
+    std::sort(values.begin(), values.end());
+
+    size_t n = values.size();
+
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Relative half-width of the 95% confidence interval of the median. The interval
+// does not assume any distribution of the samples, its bounds are the order
+// statistics at ranks (n -+ 1.96 sqrt(n)) / 2.
+double medianInterval(std::vector<double> values, double center) {
+
+    std::sort(values.begin(), values.end());
+
+    int n = (int) values.size();
+    double spread = 1.96 * sqrt((double) n);
+
+    int lower = (int) floor((n - spread) / 2) - 1;
+    int upper = (int) ceil(1 + (n + spread) / 2) - 1;
+
+    if (lower < 0) lower = 0;
+    if (upper > n - 1) upper = n - 1;
+
+    return (values[upper] - values[lower]) / 2 / center;
+}
+
+// Collects the durations returned by the sample function. The function is first
+// called until two consecutive durations differ by less than five percent so that
+// caches, frequency scaling and lazy allocation settle, then samples are taken until
+// the confidence interval of the median is tight enough or the time budget (in
+// seconds) is spent.
+template <typename F> Statistics measureRobust(F sample, double budget) {
+
+    Statistics statistics;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    double previous = sample();
+    statistics.warmup = 1;
+
+    while (statistics.warmup < HARNESS_MAXIMUM_WARMUP) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() > budget / 4) break;
+        double current = sample();
+        statistics.warmup++;
+        if (fabs(current - previous) < HARNESS_SETTLED * previous) break;
+        previous = current;
+    }
+
+    std::vector<double> samples;
+
+    while ((int) samples.size() < HARNESS_MAXIMUM_SAMPLES) {
+
+        samples.push_back(sample());
+
+        if ((int) samples.size() < HARNESS_MINIMUM_SAMPLES) continue;
+
+        statistics.median = median(samples);
+        statistics.interval = medianInterval(samples, statistics.median);
+
+        if (statistics.interval <= HARNESS_PRECISION) break;
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() > budget) break;
+    }
+
+    statistics.median = median(samples);
+    statistics.interval = medianInterval(samples, statistics.median);
+
+    std::vector<double> deviations(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+        deviations[i] = fabs(samples[i] - statistics.median);
+
+    statistics.mad = median(deviations);
+    statistics.samples = (int) samples.size();
+
+    return statistics;
+}
+
+mxArray* createStatistics(const Statistics& statistics) {
+
+    const char* fields[] = {"median", "mad", "interval", "samples", "warmup"};
+
+    mxArray* result = mxCreateStructMatrix(1, 1, 5, fields);
+
+    mxSetField(result, 0, "median", mxCreateDoubleScalar(statistics.median));
+    mxSetField(result, 0, "mad", mxCreateDoubleScalar(statistics.mad));
+    mxSetField(result, 0, "interval", mxCreateDoubleScalar(statistics.interval));
+    mxSetField(result, 0, "samples", mxCreateDoubleScalar(statistics.samples));
+    mxSetField(result, 0, "warmup", mxCreateDoubleScalar(statistics.warmup));
+
+    return result;
+}
+
+// Working set of the memory probe. The cache lines of the buffer form a single
+// random cycle (Sattolo's shuffle), every line holds the offset of the next one,
+// so each load depends on the previous one and the prefetchers cannot predict
+// it. The time of a step is the latency of the level that holds the buffer.
+class MemoryProbe {
+public:
+    MemoryProbe(size_t bytes) : stride(MEMORY_LINE / sizeof(size_t)), lines(bytes / MEMORY_LINE), buffer(lines * stride, 0) {
+
+        std::mt19937_64 generator(7);
+
+        for (size_t i = 0; i < lines; i++)
+            buffer[i * stride] = i;
+
+        for (size_t i = lines - 1; i > 0; i--) {
+            size_t j = (size_t) (generator() % i);
+            std::swap(buffer[i * stride], buffer[j * stride]);
+        }
+
+        for (size_t i = 0; i < lines; i++)
+            buffer[i * stride] *= stride;
+
+    }
+
+    // Average duration of a dependent load in seconds.
+    double latency() {
+
+        const size_t* __restrict data = &buffer[0];
+        size_t position = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < MEMORY_STEPS; i++)
+            position = data[position];
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        benchmarkSink = (float) position;
+
+        return elapsed.count() / MEMORY_STEPS;
+    }
+
+    // Duration of a sequential read of a byte in seconds, the buffer is read as
+    // many times as needed to read at least MEMORY_READ bytes.
+    double read() {
+
+        const size_t* __restrict data = &buffer[0];
+        size_t count = buffer.size();
+        size_t passes = MEMORY_READ / (count * sizeof(size_t)) + 1;
+        size_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (size_t pass = 0; pass < passes; pass++) {
+            for (size_t i = 0; i + 3 < count; i += 4) {
+                sum0 += data[i];
+                sum1 += data[i + 1];
+                sum2 += data[i + 2];
+                sum3 += data[i + 3];
+            }
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        benchmarkSink = (float) (sum0 + sum1 + sum2 + sum3);
+
+        return elapsed.count() / (passes * count * sizeof(size_t));
+    }
+
+private:
+    size_t stride;
+    size_t lines;
+    std::vector<size_t> buffer;
+};
+
+// Groups consecutive working sets with similar latency into plateaus (a level
+// of the memory hierarchy). A plateau ends when the latency grows by the factor
+// MEMORY_STEP between neighbouring working sets or exceeds the latency of its
+// first working set by the factor MEMORY_PLATEAU, working sets in the
+// transition between two levels form plateaus with a single point that are
+// dropped unless they are the last one (main memory). Every level is described
+// by its largest working set, the median latency and the median bandwidth.
+void detectLevels(const std::vector<double>& sizes, const std::vector<double>& latency,
+        const std::vector<double>& bandwidth, std::vector<double>& levels) {
+
+    size_t count = sizes.size();
+    size_t first = 0;
+
+    while (first < count) {
+
+        size_t last = first;
+
+        while (last + 1 < count && latency[last + 1] < latency[last] * MEMORY_STEP &&
+                latency[last + 1] < latency[first] * MEMORY_PLATEAU)
+            last++;
+
+        if (last > first || last + 1 == count) {
+            std::vector<double> plateauLatency(latency.begin() + first, latency.begin() + last + 1);
+            std::vector<double> plateauBandwidth(bandwidth.begin() + first, bandwidth.begin() + last + 1);
+            levels.push_back(sizes[last]);
+            levels.push_back(median(plateauLatency));
+            levels.push_back(median(plateauBandwidth));
+        }
+
+        first = last + 1;
+    }
+
+}
+
+struct BenchmarkSetup {
+    int opcode;
+    int size;
+    int kernelSize;
+    int repetitions;
+};
+
+// Creates a benchmark from validated parameters, does not call the MEX API so
+// that it can be used in worker threads.
+Benchmark* createBenchmark(const BenchmarkSetup& setup) {
+
+    switch (setup.opcode) {
+    case 3:
+        return new SgemmBenchmark(setup.size);
+    case 4:
+        return new FFTBenchmark(setup.size);
+    case 5:
+        return new BandwidthBenchmark(setup.size);
+    default:
+        return new CorrelationBenchmark(setup.size, setup.kernelSize);
+    }
+
+}
+
+// Returns the processors that the process is allowed to run on, empty if the
+// affinity cannot be queried on this platform.
+std::vector<int> getProcessors() {
+
+    std::vector<int> processors;
+
+#if defined(_WIN32)
+    DWORD_PTR process, system;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process, &system)) {
+        for (int i = 0; i < (int) sizeof(DWORD_PTR) * 8; i++)
+            if (process & ((DWORD_PTR) 1 << i)) processors.push_back(i);
+    }
+#elif defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int i = 0; i < CPU_SETSIZE; i++)
+            if (CPU_ISSET(i, &allowed)) processors.push_back(i);
+    }
+#endif
+
+    return processors;
+}
+
+// Pins the calling thread to a single processor.
+bool pinThread(int processor) {
+
+#if defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << processor) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(processor, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+
+}
+
+// Runs an independent copy of the benchmark (with its own data) in each of the
+// threads at the same time and returns the time from the common start until the
+// last thread finishes divided by the number of repetitions (every thread runs
+// the benchmark once before the start to warm up its data). The threads are
+// created for every measurement instead of using a pool so that each of them
+// can be pinned to its own processor. Returns a negative value if the data
+// cannot be allocated.
+double measureConcurrent(const BenchmarkSetup& setup, int threads, const std::vector<int>& processors, bool pin, bool& pinned) {
+
+    std::atomic<int> ready(0);
+    std::atomic<int> failed(0);
+    std::atomic<int> unpinned(0);
+    std::atomic<bool> started(false);
+
+    std::vector<std::chrono::steady_clock::time_point> finished(threads);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+
+            if (pin && (processors.empty() || !pinThread(processors[t % processors.size()])))
+                unpinned++;
+
+            Benchmark* benchmark = NULL;
+
+            try {
+                benchmark = createBenchmark(setup);
+            } catch (std::bad_alloc&) {
+                failed++;
+            }
+
+            if (benchmark) {
+                benchmark->run();
+                benchmarkSink = benchmark->check();
+            }
+
+            ready++;
+
+            while (!started.load())
+                std::this_thread::yield();
+
+            if (benchmark) {
+                for (int i = 0; i < setup.repetitions; i++) {
+                    benchmark->run();
+                    benchmarkSink = benchmark->check();
+                }
+            }
+
+            finished[t] = std::chrono::steady_clock::now();
+
+            delete benchmark;
+
+        }));
+    }
+
+    while (ready.load() < threads)
+        std::this_thread::yield();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    started = true;
+
+    for (int t = 0; t < threads; t++)
+        workers[t].join();
+
+    pinned = unpinned.load() == 0;
+
+    if (failed.load() > 0) return -1;
+
+    std::chrono::steady_clock::time_point end = start;
+
+    for (int t = 0; t < threads; t++)
+        if (finished[t] > end) end = finished[t];
+
+    std::chrono::duration<double> elapsed = end - start;
+
+    return elapsed.count() / setup.repetitions;
+}
+
 int getSingleInteger(const mxArray *arg) {
 
 	if (mxGetM(arg) != 1 || mxGetN(arg) != 1)
@@ -139,9 +755,159 @@ int getOperationIndex(char* operation) {
         return 2;
     }
 
+    if (strcmp(operation, "sgemm") == 0) {
+        return 3;
+    }
+
+    if (strcmp(operation, "fft") == 0) {
+        return 4;
+    }
+
+    if (strcmp(operation, "bandwidth") == 0) {
+        return 5;
+    }
+
+    if (strcmp(operation, "correlation") == 0) {
+        return 6;
+    }
+
+    if (strcmp(operation, "scaling") == 0) {
+        return 7;
+    }
+
+    if (strcmp(operation, "system") == 0) {
+        return 8;
+    }
+
+    if (strcmp(operation, "latency") == 0) {
+        return 9;
+    }
+
     return 0;
 }
 
+// Reads the first line of a small text file, empty if the file does not exist.
+std::string readLine(const std::string& filename) {
+
+    FILE* file = fopen(filename.c_str(), "r");
+
+    if (!file) return std::string();
+
+    char buffer[256];
+    std::string line;
+
+    if (fgets(buffer, sizeof(buffer), file)) {
+        line = buffer;
+        while (!line.empty() && (line[line.size() - 1] == '\n' || line[line.size() - 1] == '\r'))
+            line.erase(line.size() - 1);
+    }
+
+    fclose(file);
+
+    return line;
+}
+
+// Formats a list of processors as ranges, e.g. 0-3,8.
+std::string formatProcessors(const std::vector<int>& processors) {
+
+    std::string result;
+    char buffer[32];
+
+    for (size_t i = 0; i < processors.size(); ) {
+        size_t j = i;
+        while (j + 1 < processors.size() && processors[j + 1] == processors[j] + 1) j++;
+        if (j > i)
+            sprintf(buffer, "%s%d-%d", result.empty() ? "" : ",", processors[i], processors[j]);
+        else
+            sprintf(buffer, "%s%d", result.empty() ? "" : ",", processors[i]);
+        result += buffer;
+        i = j + 1;
+    }
+
+    return result;
+}
+
+// Describes the conditions of the measurement: the processors that the process
+// may run on, the frequency governor and frequencies of the first of them (in
+// MHz) and whether boost (turbo) is enabled. Values that cannot be determined on
+// this platform are empty strings or NaN.
+mxArray* createSystemInformation() {
+
+    const char* fields[] = {"hardware_threads", "processors", "affinity", "governor",
+        "frequency", "frequency_maximum", "boost"};
+
+    mxArray* result = mxCreateStructMatrix(1, 1, 7, fields);
+
+    std::vector<int> processors = getProcessors();
+
+    mxSetField(result, 0, "hardware_threads", mxCreateDoubleScalar(std::thread::hardware_concurrency()));
+    mxSetField(result, 0, "processors", mxCreateDoubleScalar(processors.empty() ? NAN : (double) processors.size()));
+    mxSetField(result, 0, "affinity", mxCreateString(formatProcessors(processors).c_str()));
+
+    std::string governor;
+    double frequency = NAN, maximum = NAN, boost = NAN;
+
+#if defined(__linux__)
+    char path[128];
+    sprintf(path, "/sys/devices/system/cpu/cpu%d/cpufreq/", processors.empty() ? 0 : processors[0]);
+    std::string directory(path);
+
+    governor = readLine(directory + "scaling_governor");
+
+    std::string value = readLine(directory + "scaling_cur_freq");
+    if (!value.empty()) frequency = atof(value.c_str()) / 1000;
+
+    value = readLine(directory + "cpuinfo_max_freq");
+    if (!value.empty()) maximum = atof(value.c_str()) / 1000;
+
+    value = readLine("/sys/devices/system/cpu/intel_pstate/no_turbo");
+    if (!value.empty()) {
+        boost = atoi(value.c_str()) ? 0 : 1;
+    } else {
+        value = readLine("/sys/devices/system/cpu/cpufreq/boost");
+        if (!value.empty()) boost = atoi(value.c_str()) ? 1 : 0;
+    }
+#endif
+
+    mxSetField(result, 0, "governor", mxCreateString(governor.c_str()));
+    mxSetField(result, 0, "frequency", mxCreateDoubleScalar(frequency));
+    mxSetField(result, 0, "frequency_maximum", mxCreateDoubleScalar(maximum));
+    mxSetField(result, 0, "boost", mxCreateDoubleScalar(boost));
+
+    return result;
+}
+
+// Reads the name of a kernel benchmark and its parameters starting at the given
+// argument (sizes followed by the optional number of repetitions).
+BenchmarkSetup getBenchmarkSetup(int nrhs, const mxArray *prhs[], int first) {
+
+    BenchmarkSetup setup;
+
+    if (nrhs <= first || !mxIsChar(prhs[first])) mexErrMsgTxt("Benchmark operation must be a string");
+
+    char* operation = getString(prhs[first]);
+    setup.opcode = getOperationIndex(operation);
+    free(operation);
+
+    if (setup.opcode < 3 || setup.opcode > 6) mexErrMsgTxt("Unknown benchmark operation.");
+
+    int parameters = setup.opcode == 6 ? 2 : 1;
+
+    if( nrhs < first + 1 + parameters || nrhs > first + 2 + parameters ) mexErrMsgTxt("Illegal number of parameters.");
+
+    setup.size = getSingleInteger(prhs[first + 1]);
+    setup.kernelSize = parameters > 1 ? getSingleInteger(prhs[first + 2]) : 0;
+    setup.repetitions = nrhs > first + 1 + parameters ? getSingleInteger(prhs[first + 1 + parameters]) : 1;
+
+    if (setup.size < 1 || setup.repetitions < 1) mexErrMsgTxt("Size and repetitions must be positive.");
+
+    if (setup.opcode == 4 && (setup.size & (setup.size - 1))) mexErrMsgTxt("FFT length must be a power of two.");
+
+    if (setup.opcode == 6 && (setup.kernelSize < 1 || setup.kernelSize > setup.size))
+        mexErrMsgTxt("Kernel size must be between one and the image size.");
+
+    return setup;
+}
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 
@@ -200,6 +966,185 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 
     	maxfilter2D(source, destination, W, H, kW, kH);
         
+    } else if (opcode >= 3 && opcode <= 6) {
+
+        if( nlhs > 3 ) mexErrMsgTxt("At most three output arguments supported.");
+
+        BenchmarkSetup setup = getBenchmarkSetup(nrhs, prhs, 0);
+
+        Benchmark* benchmark = createBenchmark(setup);
+
+        Statistics statistics = measureRobust([&]() { return measure(benchmark, setup.repetitions); }, HARNESS_BUDGET);
+
+        double rate = benchmark->work() / statistics.median * 1e-9;
+
+        delete benchmark;
+
+        plhs[0] = mxCreateDoubleScalar(statistics.median);
+
+        if (nlhs > 1)
+            plhs[1] = mxCreateDoubleScalar(rate);
+
+        if (nlhs > 2)
+            plhs[2] = createStatistics(statistics);
+
+    } else if (opcode == 7) {
+
+        if( nrhs < 5 ) mexErrMsgTxt("At least five parameters required.");
+
+        if( nlhs > 4 ) mexErrMsgTxt("At most four output arguments supported.");
+
+        BenchmarkSetup setup = getBenchmarkSetup(nrhs, prhs, 3);
+
+        bool pin = mxGetNumberOfElements(prhs[2]) == 1 && mxGetScalar(prhs[2]) != 0;
+
+        std::vector<int> processors = getProcessors();
+        int available = processors.empty() ? (int) std::thread::hardware_concurrency() : (int) processors.size();
+        if (available < 1) available = 1;
+
+        std::vector<int> counts;
+
+        if (mxIsEmpty(prhs[1])) {
+            for (int count = 1; count < available; count *= 2)
+                counts.push_back(count);
+            counts.push_back(available);
+        } else {
+            if (!mxIsDouble(prhs[1])) mexErrMsgTxt("Thread counts must be a double vector");
+            double* values = mxGetPr(prhs[1]);
+            for (size_t i = 0; i < mxGetNumberOfElements(prhs[1]); i++) {
+                int count = (int) values[i];
+                if (count < 1) mexErrMsgTxt("Thread counts must be positive.");
+                counts.push_back(count);
+            }
+        }
+
+        Benchmark* reference = createBenchmark(setup);
+        double work = reference->work();
+        delete reference;
+
+        plhs[0] = mxCreateDoubleMatrix(1, counts.size(), mxREAL);
+        double* durations = mxGetPr(plhs[0]);
+
+        std::vector<double> deviations(counts.size());
+
+        bool pinnedAll = true, allocated = true;
+
+        for (size_t i = 0; i < counts.size() && allocated; i++) {
+
+            Statistics statistics = measureRobust([&]() {
+                bool pinned = true;
+                double duration = measureConcurrent(setup, counts[i], processors, pin, pinned);
+                pinnedAll = pinnedAll && pinned;
+                allocated = allocated && duration >= 0;
+                return duration;
+            }, HARNESS_BUDGET);
+
+            durations[i] = statistics.median;
+            deviations[i] = statistics.mad;
+        }
+
+        if (!allocated) mexErrMsgTxt("Unable to allocate benchmark data for all threads.");
+
+        if (pin && !pinnedAll) mexWarnMsgTxt("Unable to pin benchmark threads to processors.");
+
+        if (nlhs > 1) {
+            plhs[1] = mxCreateDoubleMatrix(1, counts.size(), mxREAL);
+            double* rates = mxGetPr(plhs[1]);
+            for (size_t i = 0; i < counts.size(); i++)
+                rates[i] = counts[i] * work / durations[i] * 1e-9;
+        }
+
+        if (nlhs > 2) {
+            plhs[2] = mxCreateDoubleMatrix(1, counts.size(), mxREAL);
+            double* threads = mxGetPr(plhs[2]);
+            for (size_t i = 0; i < counts.size(); i++)
+                threads[i] = counts[i];
+        }
+
+        if (nlhs > 3) {
+            plhs[3] = mxCreateDoubleMatrix(1, counts.size(), mxREAL);
+            double* mad = mxGetPr(plhs[3]);
+            for (size_t i = 0; i < counts.size(); i++)
+                mad[i] = deviations[i];
+        }
+
+    } else if (opcode == 8) {
+
+        if( nlhs > 1 ) mexErrMsgTxt("At most one output argument supported.");
+
+        plhs[0] = createSystemInformation();
+
+    } else if (opcode == 9) {
+
+        if( nrhs > 3 ) mexErrMsgTxt("At most three parameters supported.");
+
+        if( nlhs > 4 ) mexErrMsgTxt("At most four output arguments supported.");
+
+        // Working sets in kilobytes
+        int minimum = nrhs > 1 ? getSingleInteger(prhs[1]) : 4;
+        int maximum = nrhs > 2 ? getSingleInteger(prhs[2]) : 1024 * 1024;
+
+        if (minimum < 1 || maximum < minimum) mexErrMsgTxt("Illegal range of working sets.");
+
+        // Powers of two and the midpoints between them
+        std::vector<double> sizes;
+
+        for (double size = 1; size <= maximum; size *= 2) {
+            if (size >= minimum) sizes.push_back(size);
+            if (size * 1.5 >= minimum && size * 1.5 <= maximum && size >= 4) sizes.push_back(size * 1.5);
+        }
+
+        std::vector<double> latency, bandwidth;
+
+        for (size_t i = 0; i < sizes.size(); i++) {
+
+            MemoryProbe* probe = NULL;
+
+            try {
+                probe = new MemoryProbe((size_t) sizes[i] * 1024);
+            } catch (std::bad_alloc&) {
+                mexWarnMsgTxt("Unable to allocate the working set, stopping the memory probe.");
+                break;
+            }
+
+            Statistics loads = measureRobust([&]() { return probe->latency(); }, MEMORY_BUDGET);
+            Statistics reads = measureRobust([&]() { return probe->read(); }, MEMORY_BUDGET);
+
+            delete probe;
+
+            latency.push_back(loads.median * 1e9);
+            bandwidth.push_back(1e-9 / reads.median);
+        }
+
+        sizes.resize(latency.size());
+
+        std::vector<double> levels;
+        detectLevels(sizes, latency, bandwidth, levels);
+
+        plhs[0] = mxCreateDoubleMatrix(1, sizes.size(), mxREAL);
+        std::copy(sizes.begin(), sizes.end(), mxGetPr(plhs[0]));
+
+        if (nlhs > 1) {
+            plhs[1] = mxCreateDoubleMatrix(1, latency.size(), mxREAL);
+            std::copy(latency.begin(), latency.end(), mxGetPr(plhs[1]));
+        }
+
+        if (nlhs > 2) {
+            plhs[2] = mxCreateDoubleMatrix(1, bandwidth.size(), mxREAL);
+            std::copy(bandwidth.begin(), bandwidth.end(), mxGetPr(plhs[2]));
+        }
+
+        if (nlhs > 3) {
+            size_t count = levels.size() / 3;
+            plhs[3] = mxCreateDoubleMatrix(count, 3, mxREAL);
+            double* data = mxGetPr(plhs[3]);
+            for (size_t i = 0; i < count; i++) {
+                data[i] = levels[i * 3];
+                data[i + count] = levels[i * 3 + 1];
+                data[i + count * 2] = levels[i * 3 + 2];
+            }
+        }
+
     } else {
         mexErrMsgTxt("Unknown operation.");
     }
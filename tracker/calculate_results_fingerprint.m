@@ -1,7 +1,9 @@
 function hash = calculate_results_fingerprint(tracker, experiment, sequences)
 % calculate_results_fingerprint Calculate results hash
 %
-% Calculates a hash fingerprint based on timestamps of result files for a tracker
+% Calculates a hash fingerprint based on sizes and content of result files for a tracker.
+% The result directories are hashed natively, digests of unchanged files are cached
+% in the workspace cache directory.
 %
 % Input:
 % - tracker: Tracker structure.
@@ -11,41 +13,19 @@ function hash = calculate_results_fingerprint(tracker, experiment, sequences)
 % Output:
 % - hash: A string containing hash fingerprint.
 
-time_string = iterate(experiment, tracker, sequences, 'iterator', @fingerprint_iterator, 'context', []);
+cache_directory = fullfile(get_global_variable('directory'), 'cache', 'fingerprints');
+mkpath(cache_directory);
 
-hash = md5hash(time_string);
-
-end
-
-function context = fingerprint_iterator(event, context)
-% fingerprint_iterator Iterator function
-%
-% Iterator function that calculates parts of the fingerprint.
-%
-% Input:
-% - event (structure): Event structure.
-% - context (structure): Context structure.
-%
-% Output:
-% - context (structure): Modified context structure.
-%
+cache_file = fullfile(cache_directory, sprintf('%s_%s.txt', tracker.identifier, experiment.name));
 
+[digests, names] = results_fingerprint(fullfile(tracker.directory, experiment.name), 1, ...
+    get_global_variable('native_threads', 0), cache_file);
 
-    switch (event.type)
-        case 'sequence_enter'
-            
-            files = tracker_evaluate(event.tracker, event.sequence, event.experiment, ...
-                'scan', true);
+% Sequences without results are also part of the fingerprint
+parts = repmat({'-'}, 1, numel(sequences));
+[found, positions] = ismember(cellfun(@(x) x.name, sequences, 'UniformOutput', false), names);
+parts(found) = digests(positions(found));
 
-            dates = zeros(1, numel(files));
-            
-            for j = 1:numel(files)
-                stat = dir(files{j});
-                dates(j) = stat.datenum;
-            end; 
-            
-            context = [context, dates];
-            
-    end;
+hash = md5hash(strjoin(parts, ';'), 'Char', 'hex', [], 'xxh64');
 
 end
@@ -23,8 +23,8 @@ if ~exist(result_file, 'file')
 end;
 
 bind_within = get_global_variable('bounded_overlap', true);
-baseline = read_trajectory(result_file);
-baseline_valid = ~cellfun(@(x) numel(x) == 1, baseline, 'UniformOutput', true);
+cache = trajectory_cache();
+[baseline, baseline_types] = read_trajectory(result_file, 'matrix', cache);
 
 if bind_within
     bounds = [sequence.width, sequence.height] - 1;
@@ -41,15 +41,14 @@ for i = 2:repetitions
         break;
     end;
 
-    trial = read_trajectory(result_file);
+    [trial, trial_types] = read_trajectory(result_file, 'matrix', cache);
 
-    if all(size(baseline) == size(trial))
-        trial_valid = ~cellfun(@(x) numel(x) == 1, trial, 'UniformOutput', true);
-        if all(baseline_valid == trial_valid)
-            same = calculate_overlap(baseline(baseline_valid), trial(trial_valid), bounds) > 0.999;
-            if all(same)
-                continue;
-            end;
+    if isequal(baseline_types, trial_types)
+        % Type codes tell masks apart from polygons, special frames are skipped
+        valid = baseline_types >= 1 & baseline_types <= 3;
+        if ~any(valid) || all(calculate_overlap(baseline(valid, :), trial(valid, :), bounds, ...
+                baseline_types(valid), trial_types(valid)) > 0.999)
+            continue;
         end;
     end;    
 
@@ -58,4 +57,5 @@ for i = 2:repetitions
 
 end;
 
+end
 
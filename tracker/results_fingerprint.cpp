@@ -0,0 +1,483 @@
+//
+// Computes fingerprints of result directories from the sizes and the content
+// of the files in them. The directory tree is listed and the files are hashed
+// on the shared thread pool. Digests of files can be cached in a text file
+// where they are keyed by the device, inode, size and modification time of a
+// file, so only new or changed files are read again.
+//
+// [digests, names] = results_fingerprint(root, depth, threads, cache)
+//
+// Every directory that is depth levels below the root (e.g. depth 1 for the
+// sequences of an experiment, depth 3 for tracker/experiment/sequence in the
+// results directory) gets one digest that covers all files below it. Both
+// outputs are cell arrays of strings, names are relative to the root and use
+// the slash as a separator.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <atomic>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "mex.h"
+#include "thread_pool.h"
+#include "xxhash.h"
+
+using namespace std;
+
+char* getString(const mxArray *arg) {
+
+	if (!mxIsChar(arg) || mxGetM(arg) > 1)
+		mexErrMsgTxt("Must be a string");
+
+    int l = (int) mxGetN(arg);
+
+    char* str = (char *) malloc(sizeof(char) * (l + 1));
+
+    mxGetString(arg, str, (l + 1));
+
+    return str;
+}
+
+int getSingleInteger(const mxArray *arg) {
+
+	if (mxGetM(arg) != 1 || mxGetN(arg) != 1)
+		mexErrMsgTxt("Parameter must be a single value");
+
+    if (mxIsInt32(arg))
+        return ((int*)mxGetPr(arg))[0];
+
+    if (mxIsDouble(arg))
+        return (int) ((double*)mxGetPr(arg))[0];
+
+    return 0;
+}
+
+typedef struct file_entry {
+    string path; // Relative to the root
+    unsigned long long device;
+    unsigned long long inode;
+    unsigned long long size;
+    long long seconds;
+    long long nanoseconds;
+    unsigned long long digest;
+    bool valid;
+} file_entry;
+
+typedef struct directory_listing {
+    vector<string> directories;
+    vector<file_entry> files;
+} directory_listing;
+
+// Sidecar and temporary files are written next to the results and are not
+// part of them.
+static bool ignore_file(const string& name) {
+
+    static const char* suffixes[] = {".cache", ".part", ".tmp"};
+
+    if (name.empty() || name[0] == '.')
+        return true;
+
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t length = strlen(suffixes[i]);
+        if (name.size() > length && name.compare(name.size() - length, length, suffixes[i]) == 0)
+            return true;
+    }
+
+    return false;
+
+}
+
+static bool stat_file(const string& path, file_entry& entry) {
+
+    struct stat info;
+
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+
+    entry.device = (unsigned long long) info.st_dev;
+    entry.inode = (unsigned long long) info.st_ino;
+    entry.size = (unsigned long long) info.st_size;
+    entry.seconds = (long long) info.st_mtime;
+#if defined(__APPLE__)
+    entry.nanoseconds = (long long) info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    entry.nanoseconds = 0;
+#else
+    entry.nanoseconds = (long long) info.st_mtim.tv_nsec;
+#endif
+
+    return true;
+
+}
+
+// Lists a directory given by a path relative to the root, names of entries
+// are stored relative to the root. Does not use the MEX API.
+static void list_directory(const string& root, const string& relative, directory_listing& listing) {
+
+    string path = relative.empty() ? root : root + "/" + relative;
+    vector<string> names;
+
+#if defined(_WIN32)
+    WIN32_FIND_DATAA data;
+    HANDLE handle = FindFirstFileA((path + "\\*").c_str(), &data);
+
+    if (handle == INVALID_HANDLE_VALUE)
+        return;
+
+    do {
+        names.push_back(data.cFileName);
+    } while (FindNextFileA(handle, &data));
+
+    FindClose(handle);
+#else
+    DIR* directory = opendir(path.c_str());
+
+    if (!directory)
+        return;
+
+    struct dirent* item;
+
+    while ((item = readdir(directory)) != NULL)
+        names.push_back(item->d_name);
+
+    closedir(directory);
+#endif
+
+    for (size_t i = 0; i < names.size(); i++) {
+
+        if (ignore_file(names[i]))
+            continue;
+
+        string name = relative.empty() ? names[i] : relative + "/" + names[i];
+        struct stat info;
+
+        if (stat((root + "/" + name).c_str(), &info) != 0)
+            continue;
+
+        if (S_ISDIR(info.st_mode)) {
+            listing.directories.push_back(name);
+        } else if (S_ISREG(info.st_mode)) {
+            file_entry entry;
+            entry.path = name;
+            entry.valid = false;
+            if (stat_file(root + "/" + name, entry))
+                listing.files.push_back(entry);
+        }
+
+    }
+
+}
+
+// Hashes the content of a file, regular files are mapped to memory. Does not
+// use the MEX API.
+static bool hash_file(const string& path, unsigned long long& digest) {
+
+    XXH64_CTX context;
+    unsigned char bytes[8];
+
+    XXH64Init(&context);
+
+#if !defined(_WIN32)
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, (size_t) info.st_size, MADV_SEQUENTIAL);
+            XXH64Update(&context, (const unsigned char*) data, (size_t) info.st_size);
+            munmap(data, (size_t) info.st_size);
+            close(fd);
+            XXH64Final(bytes, &context);
+            digest = 0;
+            for (int i = 0; i < 8; i++) digest = (digest << 8) | bytes[i];
+            return true;
+        }
+    }
+
+    close(fd);
+#endif
+
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (!file)
+        return false;
+
+    vector<unsigned char> buffer(65536);
+    size_t length;
+
+    while ((length = fread(&buffer[0], 1, buffer.size(), file)) > 0)
+        XXH64Update(&context, &buffer[0], length);
+
+    bool success = !ferror(file);
+    fclose(file);
+
+    XXH64Final(bytes, &context);
+    digest = 0;
+    for (int i = 0; i < 8; i++) digest = (digest << 8) | bytes[i];
+
+    return success;
+
+}
+
+static bool same_file(const file_entry& a, const file_entry& b) {
+
+    return a.device == b.device && a.inode == b.inode && a.size == b.size &&
+        a.seconds == b.seconds && a.nanoseconds == b.nanoseconds;
+
+}
+
+#define FINGERPRINT_CACHE_HEADER "# results_fingerprint 1"
+
+static void load_cache(const string& filename, map<string, file_entry>& cache) {
+
+    FILE* file = fopen(filename.c_str(), "r");
+
+    if (!file)
+        return;
+
+    char line[4096];
+
+    if (!fgets(line, sizeof(line), file) || strncmp(line, FINGERPRINT_CACHE_HEADER, strlen(FINGERPRINT_CACHE_HEADER)) != 0) {
+        fclose(file);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+
+        file_entry entry;
+        int offset = 0;
+
+        if (sscanf(line, "%llu %llu %llu %lld %lld %llx %n", &entry.device, &entry.inode, &entry.size,
+                &entry.seconds, &entry.nanoseconds, &entry.digest, &offset) != 6 || offset == 0)
+            continue;
+
+        entry.path = line + offset;
+
+        while (!entry.path.empty() && (entry.path[entry.path.size() - 1] == '\n' || entry.path[entry.path.size() - 1] == '\r'))
+            entry.path.resize(entry.path.size() - 1);
+
+        entry.valid = true;
+        cache[entry.path] = entry;
+
+    }
+
+    fclose(file);
+
+}
+
+// The cache is written to a temporary file that is renamed, so concurrent
+// readers see either the old or the new cache.
+static void save_cache(const string& filename, const vector<file_entry>& files) {
+
+    static std::atomic<unsigned int> counter(0);
+
+    char suffix[64];
+    sprintf(suffix, ".%u.%u.tmp", (unsigned int) getpid(), counter++);
+
+    string temporary = filename + suffix;
+    FILE* file = fopen(temporary.c_str(), "w");
+
+    if (!file)
+        return;
+
+    bool success = fprintf(file, "%s\n", FINGERPRINT_CACHE_HEADER) > 0;
+
+    for (size_t i = 0; i < files.size() && success; i++) {
+        if (!files[i].valid) continue;
+        success = fprintf(file, "%llu %llu %llu %lld %lld %016llx %s\n", files[i].device, files[i].inode,
+            files[i].size, files[i].seconds, files[i].nanoseconds, files[i].digest, files[i].path.c_str()) > 0;
+    }
+
+    success = fclose(file) == 0 && success;
+
+#if defined(_WIN32)
+    if (success) remove(filename.c_str());
+#endif
+
+    if (!success || rename(temporary.c_str(), filename.c_str()) != 0)
+        remove(temporary.c_str());
+
+}
+
+static string group_name(const string& path, int depth) {
+
+    size_t position = 0;
+
+    if (depth == 0)
+        return string();
+
+    for (int i = 0; i < depth; i++) {
+        position = path.find('/', position);
+        if (position == string::npos)
+            return string();
+        position++;
+    }
+
+    return path.substr(0, position - 1);
+
+}
+
+static thread_pool pool;
+
+void release_resources() {
+
+    pool.resize(0);
+
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+    mexAtExit(release_resources);
+
+	if( nrhs < 1 || nrhs > 4 ) mexErrMsgTxt("A root directory, an optional depth, number of threads and cache file required.");
+	if( nlhs > 2 ) mexErrMsgTxt("At most two output arguments required.");
+
+	char* str = getString(prhs[0]);
+	string root = str;
+	free(str);
+
+	while (root.size() > 1 && (root[root.size() - 1] == '/' || root[root.size() - 1] == '\\'))
+		root.resize(root.size() - 1);
+
+	int depth = nrhs > 1 ? getSingleInteger(prhs[1]) : 1;
+	int threads = nrhs > 2 ? getSingleInteger(prhs[2]) : 1;
+	string cache_file;
+
+	if (nrhs > 3 && !mxIsEmpty(prhs[3])) {
+		str = getString(prhs[3]);
+		cache_file = str;
+		free(str);
+	}
+
+	if (depth < 0) mexErrMsgTxt("Depth must not be negative");
+
+	// List the tree level by level, directories of a level are listed in parallel
+	vector<file_entry> files;
+	vector<string> groups;
+	vector<string> level(1, string());
+
+	for (int d = 0; !level.empty(); d++) {
+
+		vector<directory_listing> listings(level.size());
+
+		pool.run((int) level.size(), threads, 1, [&](int i) {
+			list_directory(root, level[i], listings[i]);
+		});
+
+		vector<string> next;
+
+		for (size_t i = 0; i < listings.size(); i++) {
+			// Files above the grouping level do not belong to any group
+			if (d >= depth)
+				files.insert(files.end(), listings[i].files.begin(), listings[i].files.end());
+			next.insert(next.end(), listings[i].directories.begin(), listings[i].directories.end());
+		}
+
+		if (d == depth)
+			groups = level;
+
+		level.swap(next);
+
+	}
+
+	// Reuse cached digests of unchanged files, hash the rest in parallel
+	map<string, file_entry> cache;
+
+	if (!cache_file.empty())
+		load_cache(cache_file, cache);
+
+	bool changed = cache.size() != files.size();
+	vector<int> pending;
+
+	for (size_t i = 0; i < files.size(); i++) {
+		map<string, file_entry>::const_iterator it = cache.find(files[i].path);
+		if (it != cache.end() && same_file(it->second, files[i])) {
+			files[i].digest = it->second.digest;
+			files[i].valid = true;
+		} else {
+			pending.push_back((int) i);
+		}
+	}
+
+	pool.run((int) pending.size(), threads, 1, [&](int i) {
+		file_entry& entry = files[pending[i]];
+		entry.valid = hash_file(root + "/" + entry.path, entry.digest);
+	});
+
+	changed = changed || !pending.empty();
+
+	if (!cache_file.empty() && changed)
+		save_cache(cache_file, files);
+
+	// Combine sizes and digests of files in a group in the order of their paths
+	sort(files.begin(), files.end(), [](const file_entry& a, const file_entry& b) { return a.path < b.path; });
+	sort(groups.begin(), groups.end());
+
+	map<string, XXH64_CTX> contexts;
+
+	for (size_t i = 0; i < groups.size(); i++)
+		XXH64Init(&contexts[groups[i]]);
+
+	for (size_t i = 0; i < files.size(); i++) {
+
+		map<string, XXH64_CTX>::iterator it = contexts.find(group_name(files[i].path, depth));
+
+		if (it == contexts.end())
+			continue;
+
+		char record[64];
+		int length;
+
+		if (files[i].valid)
+			length = sprintf(record, "%llu %016llx\n", files[i].size, files[i].digest);
+		else
+			length = sprintf(record, "%llu unreadable\n", files[i].size);
+
+		XXH64Update(&it->second, (const unsigned char*) files[i].path.c_str(), files[i].path.size() + 1);
+		XXH64Update(&it->second, (const unsigned char*) record, length);
+
+	}
+
+	plhs[0] = mxCreateCellMatrix(groups.size(), 1);
+	mxArray* names = mxCreateCellMatrix(groups.size(), 1);
+
+	for (size_t i = 0; i < groups.size(); i++) {
+
+		unsigned char bytes[8];
+		char digest[17];
+
+		XXH64Final(bytes, &contexts[groups[i]]);
+
+		for (int j = 0; j < 8; j++)
+			sprintf(digest + j * 2, "%02x", bytes[j]);
+
+		mxSetCell(plhs[0], i, mxCreateString(digest));
+		mxSetCell(names, i, mxCreateString(groups[i].c_str()));
+
+	}
+
+	if (nlhs > 1) plhs[1] = names; else mxDestroyArray(names);
+
+}
@@ -18,6 +18,9 @@ function [files, metadata] = tracker_evaluate(tracker, sequence, experiment, var
 %   for files that are generated and return their list.
 % - varargin[Persist] (boolean): Do not throw error even if one was encountered during
 %   executuon of the experiment.
+% - varargin[Defer] (boolean): Do not run the tracker but return the missing repetitions
+%   as tasks in the tasks field of the metadata (see tracker_session). Experiments that
+%   do not support tasks return no tasks.
 %
 % Output:
 % - files (cell): An array of files that were generated during the evaluation.
@@ -27,11 +30,13 @@ function [files, metadata] = tracker_evaluate(tracker, sequence, experiment, var
     files = {};
     metadata.completed = true;
     persist = false;
+    defer = false;
 
     for j=1:2:length(varargin)
         switch lower(varargin{j})
             case 'scan', scan = varargin{j+1};
             case 'persist', persist = varargin{j+1};
+            case 'defer', defer = varargin{j+1};
             otherwise, error(['unrecognized argument ' varargin{j}]);
         end
     end
@@ -54,7 +59,15 @@ function [files, metadata] = tracker_evaluate(tracker, sequence, experiment, var
 
 	try
 
-	[files, metadata] = experiment_function(tracker, sequence, directory, parameters, scan);
+	if defer
+		if nargin(experiment_function) < 6
+			metadata.tasks = {};
+			return;
+		end;
+		[files, metadata] = experiment_function(tracker, sequence, directory, parameters, scan, true);
+	else
+		[files, metadata] = experiment_function(tracker, sequence, directory, parameters, scan);
+	end;
 
 	catch e
 		metadata.completed = false;
@@ -0,0 +1,145 @@
+function tracker_session(tracker, sequences, experiment)
+% tracker_session Evaluate a tracker on a set of sequences in a persistent process
+%
+% Runs the missing repetitions of an experiment on a set of sequences with as few
+% tracker processes as possible. Instead of starting a new TraX session for every
+% repetition, the running tracker is initialized again through TraX when one
+% repetition ends and the next one begins. If the tracker process crashes, the
+% interrupted repetition is left to the usual evaluation and a new process is
+% started for the remaining ones. The first three repetitions of every sequence
+% are run before the remaining ones so that deterministic trackers are still
+% detected.
+%
+% The time that a process needs to start (until it is ready to receive the first
+% frame) is not a part of the frame timing, it is measured separately and stored
+% for every repetition in the file <sequence>_<repetition>_startup.txt next to the
+% results (zero for repetitions that reused a running process).
+%
+% Input:
+% - tracker (structure): A valid tracker descriptor.
+% - sequences (cell): Array of sequence structures.
+% - experiment (structure): A valid experiment descriptor.
+%
+
+for pass = 1:2
+
+    tasks = {};
+
+    for s = 1:numel(sequences)
+        [~, metadata] = tracker_evaluate(tracker, sequences{s}, experiment, 'Defer', true);
+        if isfield(metadata, 'tasks')
+            tasks = cat(2, tasks, metadata.tasks);
+        end;
+    end;
+
+    if isempty(tasks)
+        break;
+    end;
+
+    print_text('Running %d repetitions in a persistent tracker process', numel(tasks));
+
+    print_indent(1);
+
+    completed = run_tasks(tracker, tasks);
+
+    print_indent(-1);
+
+    if ~completed
+        break;
+    end;
+
+end;
+
+end
+
+function completed = run_tasks(tracker, tasks)
+
+% The state of the session is kept in a handle object so that it is
+% available after the tracker process crashes
+progress = containers.Map();
+progress('next') = 1;
+
+completed = true;
+
+while progress('next') <= numel(tasks)
+
+    first = progress('next');
+    progress('data') = [];
+    progress('startup') = NaN;
+
+    session = struct('tasks', {tasks}, 'progress', progress, 'timer', tic);
+
+    try
+        tracker_run(tracker, @session_callback, session);
+    catch e
+        current = progress('next');
+
+        if ~isempty(progress('data')) && ~isempty(tasks{current}.abort)
+            tasks{current}.abort(progress('data'));
+        end;
+
+        print_text('Tracker process failed (%s): %s', tasks{current}.name, e.message);
+
+        if current == first
+            % The process did not complete a single repetition, the remaining
+            % repetitions are left to the usual evaluation
+            completed = false;
+            return;
+        end;
+
+        progress('next') = current + 1;
+        continue;
+    end;
+
+    if progress('next') == first
+        completed = false;
+        return;
+    end;
+
+end;
+
+end
+
+function [image, region, properties, session] = session_callback(state, session)
+
+progress = session.progress;
+task = session.tasks{progress('next')};
+
+if isempty(progress('data'))
+
+    if isnan(progress('startup'))
+        progress('startup') = toc(session.timer);
+        print_text('Tracker process started in %.3f s', progress('startup'));
+    end;
+
+    print_text('Sequence %s', task.name);
+
+    progress('data') = task.prepare();
+
+    % The tracker is initialized for the new repetition
+    state.region = [];
+
+end;
+
+[image, region, properties, data] = task.callback(state, progress('data'));
+
+progress('data') = data;
+
+if isempty(image)
+
+    task.finish(data);
+
+    csvwrite(fullfile(task.directory, sprintf('%s_%03d_startup.txt', task.sequence, task.repetition)), ...
+        progress('startup'));
+
+    progress('startup') = 0;
+    progress('data') = [];
+    progress('next') = progress('next') + 1;
+
+    if progress('next') <= numel(session.tasks)
+        [image, region, properties, session] = session_callback(state, session);
+    end;
+
+end;
+
+end
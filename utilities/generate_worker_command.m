@@ -0,0 +1,48 @@
+function command = generate_worker_command(script, log)
+% generate_worker_command Generate command line for a worker process
+%
+% This function generates the command string that starts a new instance of the
+% current interpreter (Matlab or Octave) without the user interface, evaluates
+% the given script and quits. Errors are printed to the output and the worker
+% exits with a non-zero status.
+%
+% Input:
+% - script (string): Script that is evaluated by the worker.
+% - log (string, optional): Path to a diary file of the worker.
+%
+% Output:
+% - command (string): Generated command string.
+%
+
+if nargin < 2 || isempty(log)
+    log = '';
+else
+    log = sprintf('diary ''%s'';', log);
+end;
+
+if is_octave()
+    % Workers do not need a display, e.g. on batch nodes
+    octave_flags = {'--no-window-system'};
+    if ispc()
+        octave_executable = ['"', fullfile(matlabroot, 'bin', 'octave.exe'), '"'];
+    else
+        octave_executable = fullfile(matlabroot, 'bin', 'octave');
+    end
+
+    if compare_versions(version(), '4.0.0', '>=')
+        octave_flags{end+1} = '--no-gui';
+    end
+    octave_script = sprintf('try; %s; catch ex; disp(ex.message); for i = 1:size(ex.stack) disp(''filename''); disp(ex.stack(i).file); disp(''line''); disp(ex.stack(i).line); endfor; exit(1); end; exit(0);', script);
+    command = sprintf('%s %s --eval "%s%s"', octave_executable, strjoin(octave_flags, ' '), log, octave_script);
+else
+    if ispc()
+        matlab_executable = ['"', fullfile(matlabroot, 'bin', 'matlab.exe'), '"'];
+        matlab_flags = {'-nodesktop', '-nosplash', '-wait', '-minimize'};
+    else
+        matlab_executable = fullfile(matlabroot, 'bin', 'matlab');
+        matlab_flags = {'-nodesktop', '-nosplash'};
+    end
+
+    matlab_script = sprintf('try; %s; catch ex; disp(getReport(ex)); quit(1); end; quit(0);', script);
+    command = sprintf('%s %s -r "%s%s"', matlab_executable, strjoin(matlab_flags, ' '), log, matlab_script);
+end
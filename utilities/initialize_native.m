@@ -22,11 +22,18 @@ success = true;
 
 include_paths = {fullfile(trax_path, 'src'), fullfile(trax_path, 'include')};
 
+% Native components that use the shared thread pool (utilities/thread_pool.h)
+threads_include_paths = [include_paths, {fullfile(toolkit_path, 'utilities')}];
+threads_specific = {};
+if isunix()
+    threads_specific{end+1} = '-lpthread';
+end
+
 success = success && compile_mex('region_overlap', {fullfile(toolkit_path, 'sequence', 'region_overlap.cpp'), ...
-    fullfile(trax_path, 'src', 'region.c')}, include_paths, output_path, '-DTRAX_STATIC_DEFINE');
+    fullfile(trax_path, 'src', 'region.c')}, threads_include_paths, output_path, '-DTRAX_STATIC_DEFINE', threads_specific{:});
 
 success = success && compile_mex('region_mask', {fullfile(toolkit_path, 'sequence', 'region_mask.cpp'), ...
-    fullfile(trax_path, 'src', 'region.c')}, include_paths, output_path, '-DTRAX_STATIC_DEFINE');
+    fullfile(trax_path, 'src', 'region.c')}, threads_include_paths, output_path, '-DTRAX_STATIC_DEFINE', threads_specific{:});
 
 success = success && compile_mex('region_convert', {fullfile(toolkit_path, 'sequence', 'region_convert.cpp'), ...
     fullfile(trax_path, 'src', 'region.c')}, include_paths, output_path, '-DTRAX_STATIC_DEFINE');
@@ -34,14 +41,26 @@ success = success && compile_mex('region_convert', {fullfile(toolkit_path, 'sequ
 success = success && compile_mex('read_trajectory', {fullfile(toolkit_path, 'sequence', 'read_trajectory.cpp'), ...
     fullfile(trax_path, 'src', 'region.c')}, include_paths, output_path, '-DTRAX_STATIC_DEFINE');
 
+success = success && compile_mex('frame_prefetch', {fullfile(toolkit_path, 'sequence', 'frame_prefetch.cpp')}, ...
+    {}, output_path, threads_specific{:});
+
+success = success && compile_mex('read_trajectories', {fullfile(toolkit_path, 'sequence', 'read_trajectories.cpp')}, ...
+    threads_include_paths, output_path, threads_specific{:});
+
 success = success && compile_mex('write_trajectory', {fullfile(toolkit_path, 'sequence', 'write_trajectory.cpp'), ...
     fullfile(trax_path, 'src', 'region.c')}, include_paths, output_path, '-DTRAX_STATIC_DEFINE');
 
 success = success && compile_mex('benchmark_native', {fullfile(toolkit_path, 'tracker', 'benchmark_native.cpp')}, ...
+    {}, output_path, threads_specific{:});
+
+success = success && compile_mex('results_fingerprint', {fullfile(toolkit_path, 'tracker', 'results_fingerprint.cpp')}, ...
+    {fullfile(toolkit_path, 'utilities')}, output_path, threads_specific{:});
+
+success = success && compile_mex('run_processes', {fullfile(toolkit_path, 'utilities', 'run_processes.cpp')}, ...
     {}, output_path);
 
 success = success && compile_mex('md5hash', {fullfile(toolkit_path, 'utilities', 'md5hash.cpp')}, ...
-    {}, output_path);
+    {fullfile(toolkit_path, 'utilities')}, output_path, threads_specific{:});
 
 trax_mex_path = fullfile(output_path, 'mex');
 mkpath(trax_mex_path);
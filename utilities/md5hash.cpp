@@ -74,6 +74,9 @@
 % 017: 19-Oct-2008 22:33, Accept numerical arrays as byte stream.
 % 023: 15-Dec-2009 16:53, BUGFIX: UINT32 has 32 bits on 64 bit systems now.
 %      Thanks to Sebastiaan Breedveld!
+% 024: 64 bit lengths, memory mapped files, concurrent hashing of a cell
+%      array of files.
+% 025: XXH64 as a fast non-cryptographic alternative to MD5 (5th input).
 */
 
 // Headers:
@@ -81,7 +84,22 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <vector>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "mex.h"
+#include "thread_pool.h"
+#include "xxhash.h"
 
 #ifdef HAVE_OCTAVE
 #include <stdint.h>
@@ -109,17 +127,30 @@ typedef struct {
   UCHAR buffer[64];  // input buffer
 } MD5_CTX;
 
+// Supported algorithms:
+#define HASH_MD5   0
+#define HASH_XXH64 1
+
+typedef struct {
+  int algorithm;
+  MD5_CTX md5;
+  XXH64_CTX xxh64;
+} HASH_CTX;
+
 // Prototypes:
 void MD5Init     (MD5_CTX *);
-void MD5Update   (MD5_CTX *, UCHAR *, UINT);
+void MD5Update   (MD5_CTX *, UCHAR *, size_t);
 void MD5Final    (UCHAR[16], MD5_CTX *);
 void MD5Transform(UINT32[4], UCHAR[64]);
 void MD5Encode   (UCHAR *, UINT32 *, UINT);
-void MD5Array    (UCHAR *data, mwSize N, UCHAR digest[16]);
-void MD5File     (char *FileName, UCHAR digest[16]);
-void MD5Char     (mxChar *data, mwSize N, UCHAR digest[16]);
-void ToHex       (const UCHAR In[16], char *Out, int LowerCase);
-void ToBase64    (const UCHAR In[16], char *Out);
+void HashInit    (HASH_CTX *, int Algorithm);
+void HashUpdate  (HASH_CTX *, UCHAR *, size_t);
+int  HashFinal   (UCHAR[16], HASH_CTX *);
+void HashArray   (UCHAR *data, mwSize N, int Algorithm, UCHAR digest[16]);
+int  HashFile    (const char *FileName, int Algorithm, UCHAR digest[16]);
+void HashChar    (mxChar *data, mwSize N, int Algorithm, UCHAR digest[16]);
+void ToHex       (const UCHAR *In, int Length, char *Out, int LowerCase);
+void ToBase64    (const UCHAR *In, int Length, char *Out);
 
 // Constants for MD5Transform routine:
 #define S11 7
@@ -164,8 +195,10 @@ static UCHAR PADDING[64] = {
 #define II(a, b, c, d, x, s, ac) { \
  (a) = ROTATE_LEFT((a) + I((b), (c), (d)) + (x) + (UINT32)(ac), (s)) + (b); }
 
-// Length of the file buffer (must be < 2^31 for INT conversion):
+// Length of the buffer for CHAR arrays and of the file buffer if a file
+// cannot be mapped to memory:
 #define BUFFER_LEN 1024
+#define FILE_BUFFER_LEN 65536
 static UCHAR buffer[BUFFER_LEN];
 
 // MD5 initialization. Begins an MD5 operation, writing a new context. =========
@@ -182,19 +215,20 @@ void MD5Init(MD5_CTX *context)
 
 // MD5 block update operation. Continues an MD5 message-digest operation,
 // processing another message block, and updating the context.
-void MD5Update(MD5_CTX *context, UCHAR *input, UINT inputLen)
+void MD5Update(MD5_CTX *context, UCHAR *input, size_t inputLen)
 {
   UINT index, partLen;
-  int i, inputLenM63;
+  size_t i;
+  unsigned long long bits;
 
   // Compute number of bytes mod 64:
   index = (UINT)((context->count[0] >> 3) & 0x3F);
 
-  // Update number of bits:
-  if ((context->count[0] += ((UINT32)inputLen << 3)) < ((UINT32)inputLen << 3)) {
-    context->count[1]++;
-  }
-  context->count[1] += ((UINT32)inputLen >> 29);
+  // Update number of bits (modulo 2^64):
+  bits = ((unsigned long long) context->count[1] << 32) | context->count[0];
+  bits += (unsigned long long) inputLen << 3;
+  context->count[0] = (UINT32) (bits & 0xffffffff);
+  context->count[1] = (UINT32) (bits >> 32);
 
   partLen = 64 - index;
 
@@ -203,8 +237,7 @@ void MD5Update(MD5_CTX *context, UCHAR *input, UINT inputLen)
     memcpy((POINTER)&context->buffer[index], (POINTER)input, partLen);
     MD5Transform(context->state, context->buffer);
 
-    inputLenM63 = inputLen - 63;
-    for (i = partLen; i < inputLenM63; i += 64) {
+    for (i = partLen; i + 63 < inputLen; i += 64) {
       MD5Transform(context->state, &input[i]);
     }
 
@@ -386,27 +419,59 @@ void MD5Encode(UCHAR *output, UINT32 *input, UINT len)
   }
 }
 
+// Selected algorithm: =========================================================
+void HashInit(HASH_CTX *context, int Algorithm)
+{
+  context->algorithm = Algorithm;
+
+  if (Algorithm == HASH_XXH64) {
+    XXH64Init(&context->xxh64);
+  } else {
+    MD5Init(&context->md5);
+  }
+}
+
+void HashUpdate(HASH_CTX *context, UCHAR *input, size_t inputLen)
+{
+  if (context->algorithm == HASH_XXH64) {
+    XXH64Update(&context->xxh64, input, inputLen);
+  } else {
+    MD5Update(&context->md5, input, inputLen);
+  }
+}
+
+// Returns the length of the digest in bytes:
+int HashFinal(UCHAR digest[16], HASH_CTX *context)
+{
+  if (context->algorithm == HASH_XXH64) {
+    XXH64Final(digest, &context->xxh64);
+    return 8;
+  }
+
+  MD5Final(digest, &context->md5);
+  return 16;
+}
+
+static int DigestLength(int Algorithm)
+{
+  return Algorithm == HASH_XXH64 ? 8 : 16;
+}
+
 // Calcualte digest: ===========================================================
-void MD5Char(mxChar *array, mwSize inputLen, UCHAR digest[16])
+void HashChar(mxChar *array, mwSize inputLen, int Algorithm, UCHAR digest[16])
 {
   // Process string: Matlab stores strings as mxChar, which are 2 bytes per
   // character. Octave uses one byte per character. In Matlab this function
   // considers the first byte of each CHAR only, which
   // is equivalent to calculate the sum after a conversion to a ASCII UCHAR
   // string.
-  MD5_CTX context;
-  UINT Chunk;
+  HASH_CTX context;
+  size_t Chunk;
   UCHAR *bufferP, *bufferEnd = buffer + BUFFER_LEN, *arrayP;
 
-  // Limit length to 32 bit address, because I cannot test this function
-  // with 64 bit arrays currently (under construction):
-  if (inputLen >> 31 != 0) {  // Detect sign-bit if mwSize is int
-     mexErrMsgTxt("*** md5hash[mex]: Input > 2^31 byte not handled yet.");
-  }
-
   arrayP = (UCHAR *) array;  // UCHAR *, not mxChar *!
 
-  MD5Init(&context);
+  HashInit(&context, Algorithm);
 
   // Copy chunks of input data - only the first byte of each mxChar:
   Chunk = inputLen / BUFFER_LEN;
@@ -417,7 +482,7 @@ void MD5Char(mxChar *array, mwSize inputLen, UCHAR digest[16])
         arrayP    += CHAR_STEP;
      }
 
-     MD5Update(&context, buffer, BUFFER_LEN);
+     HashUpdate(&context, buffer, BUFFER_LEN);
   }
 
   // Last chunk:
@@ -430,72 +495,98 @@ void MD5Char(mxChar *array, mwSize inputLen, UCHAR digest[16])
         arrayP    += CHAR_STEP;
      }
 
-     MD5Update(&context, buffer, Chunk);
+     HashUpdate(&context, buffer, Chunk);
   }
 
-  MD5Final(digest, &context);
+  HashFinal(digest, &context);
 
   return;
 }
 
 // Array of any type as byte stream: ===========================================
-void MD5Array(UCHAR *array, mwSize inputLen, UCHAR digest[16])
+void HashArray(UCHAR *array, mwSize inputLen, int Algorithm, UCHAR digest[16])
 {
-  MD5_CTX context;
-
-  // Limit length to 32 bit address, because I cannot test this function
-  // with 64 bit arrays currently (under construction):
-  if (inputLen >> 31 != 0) {  // Detect sign-bit if mwSize is signed int
-     mexErrMsgTxt("*** md5hash[mex]: Input > 2^31 byte not handled yet.");
-  }
+  HASH_CTX context;
 
-  MD5Init(&context);
-  MD5Update(&context, array, (UINT) inputLen);
-  MD5Final(digest, &context);
+  HashInit(&context, Algorithm);
+  HashUpdate(&context, array, (size_t) inputLen);
+  HashFinal(digest, &context);
 }
 
 // File as byte stream: ========================================================
-void MD5File(char *filename, UCHAR digest[16])
+// Regular files are mapped to memory, other files (and files that cannot be
+// mapped, e.g. on 32 bit systems) are read through a buffer. The function is
+// called from worker threads, so it does not use the MEX API. Returns 0 if the
+// file cannot be read.
+int HashFile(const char *filename, int Algorithm, UCHAR digest[16])
 {
   FILE *FID;
-  MD5_CTX context;
-  int len;
-  UINT32 allLen = 0;
+  HASH_CTX context;
+  size_t len;
+  std::vector<UCHAR> fileBuffer;
+
+  HashInit(&context, Algorithm);
+
+#if !defined(_WIN32)
+  int fd;
+  struct stat info;
+
+  if ((fd = open(filename, O_RDONLY)) < 0) {
+     return 0;
+  }
+
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+      (unsigned long long) info.st_size <= (size_t) -1) {
+     void *data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+     if (data != MAP_FAILED) {
+        madvise(data, (size_t) info.st_size, MADV_SEQUENTIAL);
+        HashUpdate(&context, (UCHAR *) data, (size_t) info.st_size);
+        munmap(data, (size_t) info.st_size);
+        close(fd);
+        HashFinal(digest, &context);
+        return 1;
+     }
+  }
+
+  close(fd);
+#endif
 
   // Open the file in binary mode:
   if ((FID = fopen(filename, "rb")) == NULL) {
-     mexPrintf("*** Error for file: [%s]\n", filename);
-     mexErrMsgTxt("*** md5hash[mex]: Cannot open file.");
+     return 0;
   }
 
-  MD5Init(&context);
-  while ((len = fread(buffer, 1, BUFFER_LEN, FID)) != 0) {
-     // Limit length to 32 bit address, because I cannot test this function
-     // with 64 bit arrays currently (under construction):
-     allLen += len;
-     if (allLen > 2147483647) {  // 2^31
-        fclose(FID);
-        mexErrMsgTxt("*** md5hash[mex]: Cannot handle files > 2.1GB yet.");
-     }
+  fileBuffer.resize(FILE_BUFFER_LEN);
 
-     MD5Update(&context, buffer, (UINT) len);
+  while ((len = fread(&fileBuffer[0], 1, FILE_BUFFER_LEN, FID)) != 0) {
+     HashUpdate(&context, &fileBuffer[0], len);
   }
-  MD5Final(digest, &context);
+
+  if (ferror(FID)) {
+     fclose(FID);
+     return 0;
+  }
+
+  HashFinal(digest, &context);
 
   fclose(FID);
+  return 1;
 }
 
-// Output of 16 UCHARs as 32 character hexadecimals: ===========================
-void ToHex(const UCHAR digest[16], char *output, int LowerCase)
+// Output of UCHARs as hexadecimals (two characters per UCHAR): ===============
+void ToHex(const UCHAR *digest, int Length, char *output, int LowerCase)
 {
   char *outputEnd;
 
+  *output = '\0';
+
   if (LowerCase) {
-    for (outputEnd = output + 32; output < outputEnd; output += 2) {
+    for (outputEnd = output + 2 * Length; output < outputEnd; output += 2) {
       sprintf(output, "%02x", *(digest++));
     }
   } else {  // Upper case:
-    for (outputEnd = output + 32; output < outputEnd; output += 2) {
+    for (outputEnd = output + 2 * Length; output < outputEnd; output += 2) {
       sprintf(output, "%02X", *(digest++));
     }
   }
@@ -504,11 +595,11 @@ void ToHex(const UCHAR digest[16], char *output, int LowerCase)
 }
 
 // BASE64 encoded output: ======================================================
-void ToBase64(const UCHAR In[16], char *Out)
+void ToBase64(const UCHAR *In, int Length, char *Out)
 {
    // The base64 encoded string is shorter than the hex string.
-   // Needed length: ((len + 2) / 3 * 4) + 1, here fixed to 22+1 here (trailing
-   // 0 included).
+   // Needed length: (len * 4 + 2) / 3 + 1, 22+1 for MD5 and 11+1 for XXH64
+   // (trailing 0 included, no padding).
    static const UCHAR B64[] =
       "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
@@ -518,7 +609,7 @@ void ToBase64(const UCHAR In[16], char *Out)
 
    p = Out;
    s = In;
-   for (i = 0; i < 5; i++) {
+   for (i = 0; i < Length / 3; i++) {
       *p++ = B64[(*s >> 2) & 0x3F];
       *p++ = B64[((*s & 0x3) << 4)   | ((s[1] & 0xF0) >> 4)];
       *p++ = B64[((s[1] & 0xF) << 2) | ((s[2] & 0xC0) >> 6)];
@@ -526,13 +617,94 @@ void ToBase64(const UCHAR In[16], char *Out)
       s   += 3;
    }
 
-   *p++ = B64[(*s >> 2) & 0x3F];
-   *p++ = B64[((*s & 0x3) << 4)];
+   if (Length % 3 == 1) {
+      *p++ = B64[(*s >> 2) & 0x3F];
+      *p++ = B64[((*s & 0x3) << 4)];
+   } else if (Length % 3 == 2) {
+      *p++ = B64[(*s >> 2) & 0x3F];
+      *p++ = B64[((*s & 0x3) << 4)   | ((s[1] & 0xF0) >> 4)];
+      *p++ = B64[((s[1] & 0xF) << 2)];
+   }
+
    *p   = '\0';
 
    return;
 }
 
+static thread_pool pool;
+
+void release_resources() {
+
+  pool.resize(0);
+
+}
+
+// Cell array of file names: ===================================================
+// The files are hashed concurrently, the digests are returned in the rows of a
+// matrix and the second output is a vector that is zero for files that
+// cannot be read (an error is raised for them if it is not requested).
+void HashFiles(int nlhs, mxArray *plhs[], const mxArray *files, UCHAR OutType, int Algorithm, int threads)
+{
+  size_t i, j, count = mxGetNumberOfElements(files);
+  int    length = DigestLength(Algorithm);
+  std::vector<std::string> names(count);
+  std::vector<UCHAR> digests(count * 16);
+  std::vector<char> status(count, 0);
+  std::vector<char> text(count * 33);
+  std::vector<const char *> rows(count);
+  char *FileName = NULL;
+
+  if (strchr("hHdDbB", OutType) == NULL || OutType == 0) {
+     mexErrMsgTxt("*** md5hash[mex]: Unknown output type.");
+  }
+
+  for (i = 0; i < count; i++) {
+     if (mxGetCell(files, i) == NULL || (FileName = mxArrayToString(mxGetCell(files, i))) == NULL) {
+        mexErrMsgTxt("*** md5hash[mex]: Cannot get file name.");
+     }
+     names[i] = FileName;
+     mxFree(FileName);
+  }
+
+  pool.run((int) count, threads, 1, [&](int k) {
+     status[k] = (char) HashFile(names[k].c_str(), Algorithm, &digests[k * 16]);
+  });
+
+  for (i = 0; i < count && nlhs < 2; i++) {
+     if (!status[i]) {
+        mexPrintf("*** Error for file: [%s]\n", names[i].c_str());
+        mexErrMsgTxt("*** md5hash[mex]: Cannot open file.");
+     }
+  }
+
+  // Create output, one digest per row:
+  if (OutType == 'd' || OutType == 'D') {
+     plhs[0] = mxCreateDoubleMatrix(count, length, mxREAL);
+     for (i = 0; i < count; i++) {
+        for (j = 0; j < (size_t) length; j++) {
+           mxGetPr(plhs[0])[j * count + i] = (double) digests[i * 16 + j];
+        }
+     }
+  } else {
+     for (i = 0; i < count; i++) {
+        if (OutType == 'b' || OutType == 'B') {
+           ToBase64(&digests[i * 16], length, &text[i * 33]);
+        } else {
+           ToHex(&digests[i * 16], length, &text[i * 33], OutType == 'h');
+        }
+        rows[i] = &text[i * 33];
+     }
+     plhs[0] = mxCreateCharMatrixFromStrings(count, count ? &rows[0] : NULL);
+  }
+
+  if (nlhs > 1) {
+     plhs[1] = mxCreateDoubleMatrix(count, 1, mxREAL);
+     for (i = 0; i < count; i++) {
+        mxGetPr(plhs[1])[i] = status[i];
+     }
+  }
+}
+
 // Main function: ==============================================================
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
@@ -543,14 +715,16 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
   char   *FileName, InType, hexOut[33], b64Out[23];
   UCHAR  digest[16], *digestP, OutType = 'h';
-  int    isFile = false, isUnicode = false;
+  int    isFile = false, isUnicode = false, Algorithm = HASH_MD5, Length;
   double *outP, *outEnd;
 
+  mexAtExit(release_resources);
+
   // Check number of inputs and outputs:
-  if (nrhs == 0 || nrhs > 3) {
-    mexErrMsgTxt("*** md5hash[mex]: 1 to 3 inputs required.");
+  if (nrhs == 0 || nrhs > 5) {
+    mexErrMsgTxt("*** md5hash[mex]: 1 to 5 inputs required.");
   }
-  if (nlhs > 1) {
+  if (nlhs > (mxIsCell(prhs[0]) ? 2 : 1)) {
     mexErrMsgTxt("*** md5hash[mex]: Too many output arguments.");
   }
 
@@ -566,7 +740,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   }  // Default otherwise!
 
   // Output type - default: hex:
-  if (nrhs == 3 && !mxIsEmpty(prhs[2])) {
+  if (nrhs >= 3 && !mxIsEmpty(prhs[2])) {
     if (mxIsChar(prhs[2]) == 0) {
       mexErrMsgTxt("*** md5hash[mex]: 3rd input must be a string.");
     }
@@ -574,23 +748,54 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     OutType = *(POINTER) mxGetData(prhs[2]);  // Just 1st character
   }
 
+  // Algorithm - default: MD5:
+  if (nrhs == 5 && !mxIsEmpty(prhs[4])) {
+    char *Name = mxIsChar(prhs[4]) ? mxArrayToString(prhs[4]) : NULL;
+    if (Name == NULL) {
+      mexErrMsgTxt("*** md5hash[mex]: 5th input must be a string.");
+    }
+    if (strcmp(Name, "xxh64") == 0 || strcmp(Name, "XXH64") == 0) {
+      Algorithm = HASH_XXH64;
+    } else if (strcmp(Name, "md5") != 0 && strcmp(Name, "MD5") != 0) {
+      mxFree(Name);
+      mexErrMsgTxt("*** md5hash[mex]: Unknown algorithm.");
+    }
+    mxFree(Name);
+  }
+
+  Length = DigestLength(Algorithm);
+
+  // Calculate check sums of a list of files (the 4th input is the number of
+  // threads, zero uses all cores):
+  if (mxIsCell(prhs[0])) {
+     if (!isFile) {
+        mexErrMsgTxt("*** md5hash[mex]: A cell array is accepted only for files.");
+     }
+     HashFiles(nlhs, plhs, prhs[0], OutType, Algorithm, nrhs > 3 && !mxIsEmpty(prhs[3]) ? (int) mxGetScalar(prhs[3]) : 0);
+     return;
+  }
+
   // Calculate check sum:
   if (isFile) {
      if ((FileName = mxArrayToString(prhs[0])) == NULL) {
         mexErrMsgTxt("*** md5hash[mex]: Cannot get file name.");
      }
-     MD5File(FileName, digest);
+     if (!HashFile(FileName, Algorithm, digest)) {
+        mexPrintf("*** Error for file: [%s]\n", FileName);
+        mxFree(FileName);
+        mexErrMsgTxt("*** md5hash[mex]: Cannot open file.");
+     }
      mxFree(FileName);
 
   } else if (mxIsNumeric(prhs[0]) || isUnicode) {
-     MD5Array((POINTER) mxGetData(prhs[0]),
-              mxGetNumberOfElements(prhs[0]) * mxGetElementSize(prhs[0]),
-              digest);
+     HashArray((POINTER) mxGetData(prhs[0]),
+               mxGetNumberOfElements(prhs[0]) * mxGetElementSize(prhs[0]),
+               Algorithm, digest);
 
   } else if (mxIsChar(prhs[0])) {
-     MD5Char((mxChar *) mxGetData(prhs[0]),
-             mxGetNumberOfElements(prhs[0]),
-             digest);
+     HashChar((mxChar *) mxGetData(prhs[0]),
+              mxGetNumberOfElements(prhs[0]),
+              Algorithm, digest);
 
   } else {
      mexErrMsgTxt("*** md5hash[mex]: Input type not accepted.");
@@ -600,16 +805,16 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   switch (OutType) {
     case 'H':
     case 'h':  // Hexadecimal upper/lower case:
-      ToHex(digest, hexOut, OutType == 'h');
+      ToHex(digest, Length, hexOut, OutType == 'h');
       plhs[0] = mxCreateString(hexOut);
       break;
 
     case 'D':
     case 'd':  // DOUBLE with integer values:
-      plhs[0] = mxCreateDoubleMatrix(1, 16, mxREAL);
+      plhs[0] = mxCreateDoubleMatrix(1, Length, mxREAL);
       outP    = mxGetPr(plhs[0]);
       digestP = digest;
-      for (outEnd = outP + 16; outP < outEnd; outP++) {
+      for (outEnd = outP + Length; outP < outEnd; outP++) {
         *outP = (double) *digestP++;
       }
       break;
@@ -618,7 +823,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     case 'b':  // Base64:
       //strtobase64(b64Out, 26, digest, 16);  // included in LCC3.8
       //b64Out[24] = '\0';
-      ToBase64(digest, b64Out);               // Locally implemented
+      ToBase64(digest, Length, b64Out);       // Locally implemented
       plhs[0] = mxCreateString(b64Out);
       break;
 
@@ -1,12 +1,15 @@
-function hash = md5hash(data, input, output) %#ok<STOUT,INUSD>
+function [hash, status] = md5hash(data, input, output, threads, algorithm) %#ok<STOUT,INUSD>
 % md5hash Calculate 128 bit MD5 checksum
 %
-% This function calculates a 128 bit checksum for arrays and files.
+% This function calculates a 128 bit checksum for arrays and files. Optionally
+% a 64 bit XXH64 hash is calculated instead, which is several times faster and
+% suitable for cache identifiers that do not need cryptographic strength.
 %
 % Input:
-%  - data (matrix, string): Data array or file name. Either numerical or CHAR array.
-%           Currently only files and arrays with up to 2^32 bytes (2.1GB) are
-%           accepted.
+%  - data (matrix, string, cell): Data array or file name. Either numerical or CHAR array.
+%           Files and arrays of any size are accepted. For the 'File' input a cell
+%           array of file names can also be given, the files are then hashed
+%           concurrently.
 %  - input (string): Type of the input, optional. Default: 'Char'.
 %           'File': Data is a file name as string. The digest is calculated
 %                   for this file.
@@ -22,12 +25,21 @@ function hash = md5hash(data, input, output) %#ok<STOUT,INUSD>
 %     - 'HEX': [1 x 32] string as uppercase hexadecimal number.
 %     - 'Dec': [1 x 16] double vector with UINT8 values.
 %     - 'Base64': [1 x 22] string, encoded to base 64 (A:Z,a:z,0:9,+,/).
+%  - threads (integer, optional): Number of threads used for a cell array of files,
+%     zero uses all available cores. Default: 0.
+%  - algorithm (string, optional): 'md5' (default) or 'xxh64'. The XXH64 digest
+%     has 8 bytes, its hex output has 16 characters, the base64 output 11 characters
+%     and the decimal output 8 values.
 %
 % Output:
 % - hash: A 128 bit number is replied in a format depending on output parameter.
+%   For a cell array of files the digests are stored in the rows of a matrix.
 %   The chance, that different data sets have the same MD5 sum is about
 %   2^128 (> 3.4 * 10^38). Therefore MD5 can be used as "finger-print"
 %   of a file rather than e.g. CRC32.
+% - status: Only for a cell array of files, a vector that is zero for files that
+%   cannot be read (their digest is zero). If it is not requested, an error is
+%   raised for such files.
 %
 % Examples:
 %   Three methods to get the MD5 of a file:
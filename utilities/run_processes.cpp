@@ -0,0 +1,490 @@
+//
+// Runs a list of shell commands as child processes, at most a given number of
+// them at the same time. Every concurrent slot is pinned to its own set of
+// processors, so processes that run at the same time (and the processes they
+// start, e.g. a tracker) do not compete for the same cores.
+//
+// [status, elapsed, slot] = run_processes(commands, slots, cores, timeout, logs, costs, dependencies)
+//
+// Slots is the number of commands that run at the same time (zero uses as many
+// slots as there are sets of cores among the processors available to MATLAB),
+// cores is the number of processors in every set (default 1). Slots never
+// share processors, if there are not enough of them the number of slots is
+// reduced with a warning. A command that runs longer than its timeout in
+// seconds (a single value or one per command, zero disables the timeout) is
+// killed together with its process group. If a cell array of log files is
+// given, the output of every command is redirected to its file.
+//
+// Without costs the commands are started in the given order. If a vector of
+// estimated costs is given, the commands are distributed to a queue for every
+// slot, longest first, each to the queue with the least total cost. A slot
+// takes commands from the front of its own queue and when it is empty steals
+// from the back of the queue with the most remaining work, so the estimates
+// only have to be roughly right. The optional cell array of dependencies lists
+// for every command the (one-based) indices of commands that have to finish
+// before it is started (regardless of their status).
+//
+// The status is the exit code of a command, 128 plus the signal number if it
+// was terminated by a signal, -1 if it timed out and -2 if it could not be
+// started. Elapsed contains the wall-clock time of the commands in seconds and
+// slot the (one-based) slot that ran a command.
+//
+// If the function is interrupted (Ctrl-C), all running commands are killed
+// together with their process groups before an error is raised. Interrupts
+// are detected with a temporary SIGINT handler and, in Matlab (compile_mex
+// links libut), also from the desktop.
+//
+// Processor affinity is only supported on Linux, the function is not available
+// on Windows.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#endif
+
+#include "mex.h"
+
+#if !defined(OCTAVE)
+extern "C" bool utIsInterruptPending();
+#endif
+
+using namespace std;
+
+#define STATUS_TIMEOUT -1
+#define STATUS_FAILED -2
+
+char* getString(const mxArray *arg) {
+
+	if (!mxIsChar(arg) || mxGetM(arg) > 1)
+		mexErrMsgTxt("Must be a string");
+
+    int l = (int) mxGetN(arg);
+
+    char* str = (char *) malloc(sizeof(char) * (l + 1));
+
+    mxGetString(arg, str, (l + 1));
+
+    return str;
+}
+
+int getSingleInteger(const mxArray *arg) {
+
+	if (mxGetM(arg) != 1 || mxGetN(arg) != 1)
+		mexErrMsgTxt("Parameter must be a single value");
+
+    if (mxIsInt32(arg))
+        return ((int*)mxGetPr(arg))[0];
+
+    if (mxIsDouble(arg))
+        return (int) ((double*)mxGetPr(arg))[0];
+
+    return 0;
+}
+
+vector<string> getStrings(const mxArray *arg) {
+
+	if (!mxIsCell(arg))
+		mexErrMsgTxt("Must be a cell array of strings");
+
+	vector<string> strings;
+
+	for (size_t i = 0; i < mxGetNumberOfElements(arg); i++) {
+		mxArray* element = mxGetCell(arg, i);
+		if (!element) mexErrMsgTxt("Must be a cell array of strings");
+		char* str = getString(element);
+		strings.push_back(str);
+		free(str);
+	}
+
+	return strings;
+}
+
+#if !defined(_WIN32)
+
+double now() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Processors that the process is allowed to run on, empty if unknown.
+vector<int> getProcessors() {
+
+	vector<int> processors;
+
+#if defined(__linux__)
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+		for (int i = 0; i < CPU_SETSIZE; i++)
+			if (CPU_ISSET(i, &allowed)) processors.push_back(i);
+	}
+#endif
+
+	return processors;
+}
+
+typedef struct process_slot {
+	vector<int> processors;
+	pid_t pid;
+	int command;
+	double start;
+} process_slot;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void interrupt_handler(int) {
+	interrupted = 1;
+}
+
+bool isInterrupted() {
+
+#if !defined(OCTAVE)
+	if (utIsInterruptPending()) return true;
+#endif
+
+	return interrupted != 0;
+}
+
+// Kills the process groups of all running commands and waits for them.
+void stopProcesses(vector<process_slot>& pool) {
+
+	for (size_t i = 0; i < pool.size(); i++) {
+		if (!pool[i].pid) continue;
+		kill(-pool[i].pid, SIGKILL);
+		waitpid(pool[i].pid, NULL, 0);
+		pool[i].pid = 0;
+	}
+
+}
+
+// Starts a command in a new process group. Everything that the child needs is
+// prepared before the fork, the child only calls async-signal-safe functions.
+pid_t startProcess(const string& command, const vector<int>& processors, const string& log) {
+
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (size_t i = 0; i < processors.size(); i++)
+		CPU_SET(processors[i], &set);
+#endif
+
+	const char* shell_command = command.c_str();
+	const char* log_file = log.empty() ? NULL : log.c_str();
+
+	pid_t pid = fork();
+
+	// The group is set in both processes, so it exists before the parent can
+	// signal it, regardless of which of them runs first
+	if (pid > 0) setpgid(pid, pid);
+
+	if (pid != 0) return pid;
+
+	setpgid(0, 0);
+
+#if defined(__linux__)
+	if (!processors.empty())
+		sched_setaffinity(0, sizeof(set), &set);
+#endif
+
+	int input = open("/dev/null", O_RDONLY);
+	if (input >= 0) {
+		dup2(input, 0);
+		close(input);
+	}
+
+	if (log_file) {
+		int output = open(log_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (output >= 0) {
+			dup2(output, 1);
+			dup2(output, 2);
+			close(output);
+		}
+	}
+
+	execl("/bin/sh", "sh", "-c", shell_command, (char*) NULL);
+
+	_exit(127);
+
+}
+
+#endif
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+	if (nrhs < 1 || nrhs > 7) mexErrMsgTxt("One to seven input arguments required.");
+
+	if (nlhs > 3) mexErrMsgTxt("At most three output arguments supported.");
+
+#if defined(_WIN32)
+
+	mexErrMsgTxt("Running processes is not supported on Windows.");
+
+#else
+
+	vector<string> commands = getStrings(prhs[0]);
+	size_t count = commands.size();
+
+	int slots = nrhs > 1 && !mxIsEmpty(prhs[1]) ? getSingleInteger(prhs[1]) : 0;
+	int cores = nrhs > 2 && !mxIsEmpty(prhs[2]) ? getSingleInteger(prhs[2]) : 1;
+
+	vector<double> timeouts(count, 0);
+
+	if (nrhs > 3 && !mxIsEmpty(prhs[3])) {
+		if (!mxIsDouble(prhs[3])) mexErrMsgTxt("Timeout must be a double value or vector");
+		size_t n = mxGetNumberOfElements(prhs[3]);
+		if (n != 1 && n != count) mexErrMsgTxt("Number of timeouts does not match the number of commands");
+		for (size_t i = 0; i < count; i++)
+			timeouts[i] = mxGetPr(prhs[3])[n == 1 ? 0 : i];
+	}
+
+	vector<string> logs;
+
+	if (nrhs > 4 && !mxIsEmpty(prhs[4])) {
+		logs = getStrings(prhs[4]);
+		if (logs.size() != count) mexErrMsgTxt("Number of log files does not match the number of commands");
+	}
+
+	vector<double> costs;
+
+	if (nrhs > 5 && !mxIsEmpty(prhs[5])) {
+		if (!mxIsDouble(prhs[5]) || mxGetNumberOfElements(prhs[5]) != count)
+			mexErrMsgTxt("Costs must be a double vector with a value for every command");
+		costs.assign(mxGetPr(prhs[5]), mxGetPr(prhs[5]) + count);
+	}
+
+	vector<vector<int> > dependencies(count);
+
+	if (nrhs > 6 && !mxIsEmpty(prhs[6])) {
+		if (!mxIsCell(prhs[6]) || mxGetNumberOfElements(prhs[6]) != count)
+			mexErrMsgTxt("Dependencies must be a cell array with an element for every command");
+		for (size_t i = 0; i < count; i++) {
+			mxArray* element = mxGetCell(prhs[6], i);
+			if (!element || mxIsEmpty(element)) continue;
+			if (!mxIsDouble(element)) mexErrMsgTxt("Dependencies must be double vectors");
+			for (size_t j = 0; j < mxGetNumberOfElements(element); j++) {
+				int dependency = (int) mxGetPr(element)[j] - 1;
+				if (dependency < 0 || dependency >= (int) count) mexErrMsgTxt("Dependency index out of range");
+				dependencies[i].push_back(dependency);
+			}
+		}
+	}
+
+	if (slots < 0 || cores < 1) mexErrMsgTxt("Illegal number of slots or cores");
+
+	vector<int> processors = getProcessors();
+
+	if (!processors.empty() && cores > (int) processors.size()) {
+		mexWarnMsgTxt("Not enough processors for the requested number of cores, using all of them in one slot.");
+		cores = (int) processors.size();
+	}
+
+	// Slots never share processors, there are at most as many of them as there
+	// are disjoint sets of cores
+	int available = processors.empty() ? 0 : (int) processors.size() / cores;
+
+	if (slots == 0)
+		slots = max(1, available);
+
+	if (available > 0 && slots > available) {
+		mexWarnMsgTxt("Not enough processors for the requested number of slots, running fewer commands at the same time.");
+		slots = available;
+	}
+
+	if (slots < 1) slots = 1;
+
+	vector<process_slot> pool(slots);
+
+	for (int i = 0; i < slots; i++) {
+		pool[i].pid = 0;
+		pool[i].command = -1;
+		for (int j = 0; j < cores && !processors.empty(); j++)
+			pool[i].processors.push_back(processors[i * cores + j]);
+	}
+
+	// Without costs all commands are kept in the first queue in the given order
+	// and every slot takes them from the front.
+	bool balanced = !costs.empty();
+	vector<deque<int> > queues(balanced ? slots : 1);
+	vector<double> load(queues.size(), 0);
+
+	if (balanced) {
+		vector<int> order(count);
+		for (size_t i = 0; i < count; i++) order[i] = (int) i;
+		stable_sort(order.begin(), order.end(), [&](int a, int b) { return costs[a] > costs[b]; });
+		for (size_t i = 0; i < count; i++) {
+			size_t target = min_element(load.begin(), load.end()) - load.begin();
+			queues[target].push_back(order[i]);
+			load[target] += costs[order[i]];
+		}
+	} else {
+		for (size_t i = 0; i < count; i++) queues[0].push_back((int) i);
+	}
+
+	vector<bool> finished(count, false);
+
+	auto ready = [&](int command) {
+		for (size_t j = 0; j < dependencies[command].size(); j++)
+			if (!finished[dependencies[command][j]]) return false;
+		return true;
+	};
+
+	// Removes the first ready command of a queue, searching from the front or
+	// from the back, and returns it or -1 if no command is ready.
+	auto take = [&](size_t queue, bool back) {
+		deque<int>& q = queues[queue];
+		for (size_t k = 0; k < q.size(); k++) {
+			size_t position = back ? q.size() - 1 - k : k;
+			int command = q[position];
+			if (!ready(command)) continue;
+			q.erase(q.begin() + position);
+			if (balanced) load[queue] -= costs[command];
+			return command;
+		}
+		return -1;
+	};
+
+	plhs[0] = mxCreateDoubleMatrix(1, count, mxREAL);
+	double* status = mxGetPr(plhs[0]);
+
+	vector<double> elapsed(count, 0);
+	vector<int> assigned(count, 0);
+
+	size_t remaining = count;
+	int running = 0;
+
+	struct sigaction action, previous;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = interrupt_handler;
+	sigemptyset(&action.sa_mask);
+	interrupted = 0;
+	sigaction(SIGINT, &action, &previous);
+
+	while (remaining > 0 || running > 0) {
+
+		if (isInterrupted()) {
+			stopProcesses(pool);
+			sigaction(SIGINT, &previous, NULL);
+			mexErrMsgTxt("Interrupted, all running commands were stopped.");
+		}
+
+		for (int i = 0; i < slots && remaining > 0; i++) {
+
+			if (pool[i].pid) continue;
+
+			int command = take(balanced ? i : 0, false);
+
+			if (command < 0 && balanced) {
+				// Steal from the queues with the most remaining work first
+				vector<size_t> victims;
+				for (size_t q = 0; q < queues.size(); q++)
+					if (q != (size_t) i && !queues[q].empty()) victims.push_back(q);
+				stable_sort(victims.begin(), victims.end(), [&](size_t a, size_t b) { return load[a] > load[b]; });
+				for (size_t v = 0; v < victims.size() && command < 0; v++)
+					command = take(victims[v], true);
+			}
+
+			if (command < 0) continue;
+
+			remaining--;
+			assigned[command] = i + 1;
+
+			pool[i].command = command;
+			pool[i].start = now();
+			pool[i].pid = startProcess(commands[command], pool[i].processors, logs.empty() ? string() : logs[command]);
+
+			if (pool[i].pid < 0) {
+				status[command] = STATUS_FAILED;
+				finished[command] = true;
+				pool[i].pid = 0;
+			} else {
+				running++;
+			}
+
+		}
+
+		// Dependencies that can never be satisfied (a cycle)
+		if (running == 0 && remaining > 0) {
+			for (size_t q = 0; q < queues.size(); q++) {
+				for (size_t k = 0; k < queues[q].size(); k++) {
+					status[queues[q][k]] = STATUS_FAILED;
+					finished[queues[q][k]] = true;
+				}
+				queues[q].clear();
+			}
+			remaining = 0;
+			break;
+		}
+
+		for (int i = 0; i < slots; i++) {
+
+			if (!pool[i].pid) continue;
+
+			int code;
+			int command = pool[i].command;
+			pid_t result = waitpid(pool[i].pid, &code, WNOHANG);
+
+			if (result == 0) {
+				if (timeouts[command] > 0 && now() - pool[i].start > timeouts[command]) {
+					kill(-pool[i].pid, SIGKILL);
+					waitpid(pool[i].pid, &code, 0);
+					status[command] = STATUS_TIMEOUT;
+				} else continue;
+			} else if (result < 0) {
+				status[command] = STATUS_FAILED;
+			} else if (WIFEXITED(code)) {
+				status[command] = WEXITSTATUS(code);
+			} else if (WIFSIGNALED(code)) {
+				status[command] = 128 + WTERMSIG(code);
+			} else continue;
+
+			elapsed[command] = now() - pool[i].start;
+			finished[command] = true;
+			pool[i].pid = 0;
+			running--;
+		}
+
+		if (running > 0) {
+			struct timespec delay = {0, 10000000};
+			nanosleep(&delay, NULL);
+		}
+
+	}
+
+	sigaction(SIGINT, &previous, NULL);
+
+	if (nlhs > 1) {
+		plhs[1] = mxCreateDoubleMatrix(1, count, mxREAL);
+		double* times = mxGetPr(plhs[1]);
+		for (size_t i = 0; i < count; i++)
+			times[i] = elapsed[i];
+	}
+
+	if (nlhs > 2) {
+		plhs[2] = mxCreateDoubleMatrix(1, count, mxREAL);
+		double* slot = mxGetPr(plhs[2]);
+		for (size_t i = 0; i < count; i++)
+			slot[i] = assigned[i];
+	}
+
+#endif
+
+}
+
@@ -0,0 +1,144 @@
+// thread_pool.h
+// A minimal pool of worker threads shared by the native components of the
+// toolkit. The pool is meant to live in a static variable of a MEX function so
+// that the threads survive between calls, it has to be shut down with
+// resize(0) in a mexAtExit handler before the MEX file is unloaded.
+//
+// Work is submitted as a range of indices that the workers (and the calling
+// thread) claim in chunks, so unevenly expensive items balance themselves.
+// The function that processes an item must not call the MEX API, all input
+// has to be extracted and all output allocated in the calling thread.
+
+#ifndef TOOLKIT_THREAD_POOL_H
+#define TOOLKIT_THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+class thread_pool {
+public:
+
+    thread_pool() : stopping(false), generation(0), active(0), task(NULL), next(0), total(0), chunk(1) {}
+
+    ~thread_pool() { resize(0); }
+
+    // Number of threads that process the work including the calling thread,
+    // zero selects the number of hardware threads.
+    static int concurrency(int threads) {
+        if (threads > 0) return threads;
+        int hardware = (int) std::thread::hardware_concurrency();
+        return hardware > 0 ? hardware : 1;
+    }
+
+    void resize(int workers) {
+
+        if (workers == (int) this->workers.size()) return;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+
+        for (size_t i = 0; i < this->workers.size(); i++)
+            this->workers[i].join();
+
+        this->workers.clear();
+        stopping = false;
+
+        for (int i = 0; i < workers; i++)
+            this->workers.push_back(std::thread(&thread_pool::work, this, generation));
+
+    }
+
+    // Calls function(i) for i in [0, count) using the given number of
+    // threads (see concurrency) and returns when all items are processed.
+    template <typename F> void run(int count, int threads, int chunk, F function) {
+
+        threads = concurrency(threads);
+
+        if (threads < 2 || count <= chunk) {
+            for (int i = 0; i < count; i++) function(i);
+            return;
+        }
+
+        resize(threads - 1);
+
+        std::function<void(int)> wrapper(function);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task = &wrapper;
+            total = count;
+            this->chunk = chunk;
+            next = 0;
+            active = (int) workers.size();
+            generation++;
+        }
+        wakeup.notify_all();
+
+        process();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (active > 0) finished.wait(lock);
+            task = NULL;
+        }
+
+    }
+
+private:
+
+    void process() {
+
+        while (true) {
+            int start = next.fetch_add(chunk);
+            if (start >= total) break;
+            int end = start + chunk < total ? start + chunk : total;
+            for (int i = start; i < end; i++) (*task)(i);
+        }
+
+    }
+
+    void work(unsigned long seen) {
+
+        while (true) {
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!stopping && generation == seen) wakeup.wait(lock);
+                if (stopping) return;
+                seen = generation;
+            }
+
+            process();
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (--active == 0) finished.notify_all();
+            }
+
+        }
+
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    bool stopping;
+    unsigned long generation;
+    int active;
+
+    std::function<void(int)>* task;
+    std::atomic<int> next;
+    int total;
+    int chunk;
+
+};
+
+#endif
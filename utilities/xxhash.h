@@ -0,0 +1,159 @@
+// xxhash.h
+// XXH64, a non-cryptographic 64 bit hash by Yann Collet (BSD license). It is
+// several times faster than MD5 and is used where cryptographic strength is
+// not needed, e.g. for cache identifiers and fingerprints of result files.
+// The digest is stored in big endian byte order, so its hex form is the same
+// as the output of xxhsum. The seed is zero.
+
+#ifndef TOOLKIT_XXHASH_H
+#define TOOLKIT_XXHASH_H
+
+#include <stddef.h>
+#include <string.h>
+
+typedef struct {
+  unsigned long long state[4];  // accumulators
+  unsigned long long length;    // number of bytes
+  unsigned char buffer[32];     // input buffer
+  unsigned int size;            // number of bytes in the buffer
+} XXH64_CTX;
+
+#define XXH_PRIME1 11400714785074694791ULL
+#define XXH_PRIME2 14029467366897019727ULL
+#define XXH_PRIME3  1609587929392839161ULL
+#define XXH_PRIME4  9650029242287828579ULL
+#define XXH_PRIME5  2870177450012600261ULL
+
+#define XXH_ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+static inline unsigned long long XXH64Read64(const unsigned char *p)
+{
+  return  (unsigned long long)p[0]        | ((unsigned long long)p[1] << 8)  | ((unsigned long long)p[2] << 16) |
+         ((unsigned long long)p[3] << 24) | ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40) |
+         ((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+}
+
+static inline unsigned long long XXH64Read32(const unsigned char *p)
+{
+  return (unsigned long long)p[0] | ((unsigned long long)p[1] << 8) | ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24);
+}
+
+static inline unsigned long long XXH64Round(unsigned long long acc, unsigned long long input)
+{
+  acc += input * XXH_PRIME2;
+  acc  = XXH_ROTATE_LEFT(acc, 31);
+  return acc * XXH_PRIME1;
+}
+
+static inline unsigned long long XXH64Merge(unsigned long long acc, unsigned long long value)
+{
+  acc ^= XXH64Round(0, value);
+  return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+static inline void XXH64Init(XXH64_CTX *context)
+{
+  context->state[0] = XXH_PRIME1 + XXH_PRIME2;
+  context->state[1] = XXH_PRIME2;
+  context->state[2] = 0;
+  context->state[3] = 0 - XXH_PRIME1;
+  context->length = 0;
+  context->size = 0;
+}
+
+static inline void XXH64Update(XXH64_CTX *context, const unsigned char *input, size_t inputLen)
+{
+  const unsigned char *end = input + inputLen;
+  unsigned long long v1, v2, v3, v4;
+
+  context->length += inputLen;
+
+  // Not enough data for a stripe of 32 bytes:
+  if (context->size + inputLen < 32) {
+    memcpy(context->buffer + context->size, input, inputLen);
+    context->size += (unsigned int) inputLen;
+    return;
+  }
+
+  v1 = context->state[0];
+  v2 = context->state[1];
+  v3 = context->state[2];
+  v4 = context->state[3];
+
+  // Complete the buffered stripe:
+  if (context->size > 0) {
+    memcpy(context->buffer + context->size, input, 32 - context->size);
+    input += 32 - context->size;
+    v1 = XXH64Round(v1, XXH64Read64(context->buffer));
+    v2 = XXH64Round(v2, XXH64Read64(context->buffer + 8));
+    v3 = XXH64Round(v3, XXH64Read64(context->buffer + 16));
+    v4 = XXH64Round(v4, XXH64Read64(context->buffer + 24));
+    context->size = 0;
+  }
+
+  while (input + 32 <= end) {
+    v1 = XXH64Round(v1, XXH64Read64(input));
+    v2 = XXH64Round(v2, XXH64Read64(input + 8));
+    v3 = XXH64Round(v3, XXH64Read64(input + 16));
+    v4 = XXH64Round(v4, XXH64Read64(input + 24));
+    input += 32;
+  }
+
+  context->state[0] = v1;
+  context->state[1] = v2;
+  context->state[2] = v3;
+  context->state[3] = v4;
+
+  // Buffer remaining input:
+  memcpy(context->buffer, input, end - input);
+  context->size = (unsigned int) (end - input);
+}
+
+static inline void XXH64Final(unsigned char digest[8], XXH64_CTX *context)
+{
+  const unsigned char *p = context->buffer, *end = context->buffer + context->size;
+  unsigned long long h;
+  int i;
+
+  if (context->length >= 32) {
+    h = XXH_ROTATE_LEFT(context->state[0], 1) + XXH_ROTATE_LEFT(context->state[1], 7) +
+        XXH_ROTATE_LEFT(context->state[2], 12) + XXH_ROTATE_LEFT(context->state[3], 18);
+    h = XXH64Merge(h, context->state[0]);
+    h = XXH64Merge(h, context->state[1]);
+    h = XXH64Merge(h, context->state[2]);
+    h = XXH64Merge(h, context->state[3]);
+  } else {
+    h = XXH_PRIME5;
+  }
+
+  h += context->length;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= XXH64Round(0, XXH64Read64(p));
+    h  = XXH_ROTATE_LEFT(h, 27) * XXH_PRIME1 + XXH_PRIME4;
+  }
+
+  if (p + 4 <= end) {
+    h ^= XXH64Read32(p) * XXH_PRIME1;
+    h  = XXH_ROTATE_LEFT(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+    p += 4;
+  }
+
+  for (; p < end; p++) {
+    h ^= (*p) * XXH_PRIME5;
+    h  = XXH_ROTATE_LEFT(h, 11) * XXH_PRIME1;
+  }
+
+  // Avalanche:
+  h ^= h >> 33;
+  h *= XXH_PRIME2;
+  h ^= h >> 29;
+  h *= XXH_PRIME3;
+  h ^= h >> 32;
+
+  for (i = 0; i < 8; i++) {
+    digest[i] = (unsigned char) (h >> (56 - 8 * i));
+  }
+}
+
+#endif
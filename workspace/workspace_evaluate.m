@@ -8,7 +8,9 @@ function workspace_evaluate(trackers, sequences, experiments, varargin)
 % - trackers (cell or structure): Array of tracker structures.
 % - sequences (cell or structure): Array of sequence structures.
 % - experiments (cell or structure): Array of experiment structures.
-% - varargin[Mode] (string, optional): Evaluation mode, at the moment only 'execute' mode is supported.
+% - varargin[Mode] (string, optional): Evaluation mode, 'sequential' (default),
+% 'parallel' (a pool of Matlab workers), 'makefile' (export of jobs to a
+% Makefile) or 'native' (a pool of worker processes with a native scheduler).
 % - varargin[Variables] (struct, optional): Additional global variables to
 % be merged with (override) the existing ones.
 % - varargin[Persist] (boolean, optional): Only applicable to 'sequential'
@@ -17,14 +19,20 @@ function workspace_evaluate(trackers, sequences, experiments, varargin)
 % - varargin[Log] (boolean, optional): Write a dedicated execution log to a
 % file.
 % - varargin[Pool] (integer, optional): Size of executor pool, only
-% applicable to 'parallel' execution mode.
+% applicable to 'parallel' (default 1) and 'native' (default 0, all
+% available processors) execution modes.
+% - varargin[Timeout] (double, optional): Minimum time limit in seconds for a
+% single repetition, only applicable to 'native' execution mode. The limit of
+% a repetition is extended to its estimated duration multiplied by the global
+% variable native_timeout_scale. Default: 0 (no limit).
 %
 
 mode = 'sequential';
 variables = [];
 persist = false;
 log = false;
-pool = 1;
+pool = [];
+timeout = 0;
 postprocess = [];
 
 for j=1:2:length(varargin)
@@ -34,6 +42,7 @@ for j=1:2:length(varargin)
         case 'persist', persist = varargin{j+1};
         case 'pool', pool = varargin{j+1};
         case 'log', log = varargin{j+1};
+        case 'timeout', timeout = varargin{j+1};
         otherwise, error(['unrecognized argument ', varargin{j}]);
     end
 end
@@ -54,12 +63,15 @@ switch lower(mode)
             cleanup = onCleanup(@() diary('off') );
         end
         iterator = @execute_iterator;
-        context = struct('persist', persist, 'errors', 0);
+        context = struct('persist', persist, 'errors', 0, 'sequences', {sequences});
         postprocess = @execute_join;
     case 'parallel'
         if is_octave()
             error('Parallel execution not available in Octave.');
         end;
+        if isempty(pool)
+            pool = 1;
+        end;
         if isempty(gcp('nocreate'))
             parpool(pool);
         end
@@ -87,6 +99,28 @@ switch lower(mode)
             mkpath(log);
             context.logdir = log;
         end
+    case 'native'
+        if ~isunix
+            error('Native execution only supported on Unix-like systems.');
+        end;
+        if isempty(pool)
+            pool = 0;
+        end;
+        iterator = @native_iterator;
+        context = struct('persist', persist, 'pool', pool, 'timeout', timeout, 'logdir', [], ...
+            'jobs', struct('tracker', {}, 'sequence', {}, 'command', {}, 'log', {}, ...
+            'repetition', {}, 'dependencies', {}, 'job_file', {}, 'time_file', {}));
+        context.trackers = trackers;
+        context.sequences = sequences;
+        context.experiments = experiments;
+        if log
+            if islogical(log)
+                log = fullfile(get_global_variable('directory'), 'logs', datestr(now, 30));
+            end;
+            mkpath(log);
+            context.logdir = log;
+        end
+        postprocess = @native_join;
     otherwise, error(['unrecognized mode ', mode]);
 end
 
@@ -116,6 +150,17 @@ function context = execute_iterator(event, context)
 
         print_indent(1);
 
+        % Missing repetitions of all sequences are run in a single tracker
+        % process first, the sequential pass then collects the results
+        if isfield(context, 'sequences') && get_global_variable('trax_persistent', false) && ...
+                get_global_variable('experiment_cache', true)
+            try
+                tracker_session(event.tracker, convert_sequences(context.sequences, event.experiment.converter), event.experiment);
+            catch e
+                print_text('Persistent tracker session interrupted: %s', e.message);
+            end;
+        end;
+
     case 'tracker_exit'
 
         print_indent(-1);
@@ -268,36 +313,10 @@ switch (event.type)
         
         log = '';
         if ~isempty(context.logdir)
-            log = sprintf('diary ''%s'';', fullfile('${LOGDIR}', ...
-                sprintf('%s-%s-%s.log', event.tracker.identifier, event.experiment.name, event.sequence.name)));
-        end
-        
-        if is_octave()
-            octave_flags = {};
-            if ispc()
-                octave_executable = ['"', fullfile(matlabroot, 'bin', 'octave.exe'), '"'];
-            else
-                octave_executable = fullfile(matlabroot, 'bin', 'octave');
-            end
-            
-            if compare_versions(version(), '4.0.0', '>=')
-                octave_flags{end+1} = '--no-gui';
-            end
-            octave_script = sprintf('try; %s; catch ex; disp(ex.message); for i = 1:size(ex.stack) disp(''filename''); disp(ex.stack(i).file); disp(''line''); disp(ex.stack(i).line); endfor; end; quit;', script);
-            command = sprintf('%s %s --eval "%s%s"', octave_executable, strjoin(octave_flags, ' '), log, octave_script);
-        else
-            if ispc()
-                matlab_executable = ['"', fullfile(matlabroot, 'bin', 'matlab.exe'), '"'];
-                matlab_flags = {'-nodesktop', '-nosplash', '-wait', '-minimize'};
-            else
-                matlab_executable = fullfile(matlabroot, 'bin', 'matlab');
-                matlab_flags = {'-nodesktop', '-nosplash'};
-            end
-            
-            matlab_script = sprintf('try; %s; catch ex; disp(getReport(ex)); end; quit;', script);
-            command = sprintf('%s %s -r "%s%s"', matlab_executable, strjoin(matlab_flags, ' '), log, matlab_script);
-            
+            log = fullfile('${LOGDIR}', sprintf('%s-%s-%s.log', event.tracker.identifier, event.experiment.name, event.sequence.name));
         end
+
+        command = generate_worker_command(script, log);
         
         fprintf(context.file, '\t@echo "[%*d%%] %s %s %s"\n', 3, round((context.current * 100) / context.total), ...
             tracker.identifier, experiment.name, sequence.name);
@@ -308,3 +327,143 @@ switch (event.type)
 end;
 
 end
+
+function context = native_iterator(event, context)
+
+switch (event.type)
+    case 'enter'
+
+        context.jobdir = fullfile(get_global_variable('directory'), 'cache', 'nativejobs');
+        mkpath(context.jobdir);
+
+        if isempty(context.logdir)
+            context.logdir = fullfile(get_global_variable('directory'), 'logs', datestr(now, 30));
+        end;
+        mkpath(context.logdir);
+
+    case 'sequence_enter'
+
+        tracker = event.tracker;
+        sequence = event.sequence;
+        experiment = event.experiment;
+
+        [~, metadata] = tracker_evaluate(tracker, sequence, experiment, 'scan', true);
+
+        if ~isfield(metadata, 'pending') || isempty(metadata.pending)
+            return;
+        end;
+
+        globals = get_global_variable(); %#ok<NASGU>
+
+        job_file = fullfile(context.jobdir, sprintf('%s_%s_%s.mat', ...
+            tracker.identifier, experiment.name, sequence.name));
+
+        save(job_file, 'tracker', 'sequence', 'experiment', 'globals');
+
+        time_file = fullfile(tracker.directory, experiment.name, sequence.name, ...
+            sprintf('%s_time.txt', sequence.name));
+
+        % Repetitions after the third one wait for the first three, so that
+        % deterministic trackers are still detected by the workers
+        first = numel(context.jobs) + find(metadata.pending <= 3);
+
+        for i = metadata.pending
+
+            script = sprintf(['addpath(''%s''); toolkit_path; load(''%s''); set_global_variable(globals); ', ...
+                'set_global_variable(''experiment_repetition'', %d); tracker_evaluate(tracker, sequence, experiment)'], ...
+                get_global_variable('toolkit_path'), job_file, i);
+
+            job.tracker = event.tracker_index;
+            job.sequence = sequence;
+            job.command = generate_worker_command(script);
+            job.log = fullfile(context.logdir, sprintf('%s-%s-%s-%03d.log', tracker.identifier, ...
+                experiment.name, sequence.name, i));
+            job.repetition = i;
+            job.dependencies = [];
+            if i > 3
+                job.dependencies = first;
+            end;
+            job.job_file = job_file;
+            job.time_file = time_file;
+
+            context.jobs(end+1) = job;
+
+        end;
+
+end;
+
+end
+
+function native_join(context)
+
+jobs = context.jobs;
+
+if ~isempty(jobs)
+
+    % The speed of a tracker is estimated from the timing of its existing results,
+    % the default of estimate_completion_time is used for trackers without them
+    fps = 0.5 * ones(numel(context.trackers), 1);
+
+    for t = 1:numel(context.trackers)
+        time_files = unique({jobs([jobs.tracker] == t).time_file});
+        frames = 0;
+        total = 0;
+        for f = 1:numel(time_files)
+            if ~exist(time_files{f}, 'file')
+                continue;
+            end;
+            times = csvread(time_files{f});
+            frames = frames + sum(times(:) > 0);
+            total = total + sum(times(times(:) > 0));
+        end;
+        if frames > 0 && total > 0
+            fps(t) = frames / total;
+        end;
+    end;
+
+    costs = arrayfun(@(job) estimate_completion_time({job.sequence}, 'fps', fps(job.tracker)), jobs);
+
+    % Jobs on long sequences or of slow trackers get a longer time limit
+    timeouts = zeros(size(costs));
+    if context.timeout > 0
+        timeouts = max(context.timeout, get_global_variable('native_timeout_scale', 3) * costs);
+    end;
+
+    print_text('Running %d jobs in native scheduler', numel(jobs));
+
+    [status, elapsed] = run_processes({jobs.command}, context.pool, get_global_variable('experiment_cores', 1), ...
+        timeouts, {jobs.log}, costs, {jobs.dependencies});
+
+    cleanup = get_global_variable('log_autocleanup', true);
+
+    for j = 1:numel(jobs)
+        if status(j) == 0
+            if cleanup
+                delete(jobs(j).log);
+            end;
+        elseif status(j) == -1
+            print_text('Repetition %d of sequence %s timed out after %.1f s, see %s', ...
+                jobs(j).repetition, jobs(j).sequence.name, elapsed(j), jobs(j).log);
+        else
+            print_text('Repetition %d of sequence %s failed, see %s', ...
+                jobs(j).repetition, jobs(j).sequence.name, jobs(j).log);
+        end;
+    end;
+
+    job_files = unique({jobs.job_file});
+    for f = 1:numel(job_files)
+        delete(job_files{f});
+    end;
+
+end;
+
+% The sequential pass merges the timing of the workers and completes the
+% repetitions that the workers did not
+print_text('Collecting results');
+
+context = iterate(context.experiments, context.trackers, context.sequences, ...
+    'iterator', @execute_iterator, 'context', struct('persist', context.persist, 'errors', 0));
+
+execute_join(context);
+
+end
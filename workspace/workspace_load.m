@@ -71,8 +71,18 @@ set_global_variable('cleanup', 1);
 set_global_variable('trax_mex', []);
 set_global_variable('trax_client', []);
 set_global_variable('trax_timeout', 30);
+set_global_variable('trax_persistent', false);
 set_global_variable('matlab_startup_model', [923.5042, -4.2525]);
 set_global_variable('legacy_rasterization', false);
+set_global_variable('exact_overlap', false);
+set_global_variable('native_threads', 0);
+set_global_variable('native_timeout_scale', 3);
+set_global_variable('trajectory_cache', true);
+set_global_variable('trajectory_flush', 10);
+set_global_variable('prefetch_frames', 8);
+set_global_variable('prefetch_mode', 'advise');
+set_global_variable('experiment_concurrency', 1);
+set_global_variable('experiment_cores', 1);
 set_global_variable('native_path', fullfile(get_global_variable('toolkit_path'), 'native'));
 
 if only_defaults